@@ -0,0 +1,216 @@
+/*
+ * Host (linux target) profiling app for esp_littlefs.
+ *
+ * Runs a few benchmark workloads against the emulated flash and reports wall
+ * clock time next to the device time modelled by CONFIG_LITTLEFS_FLASH_SIM.
+ * Set LITTLEFS_FLASH_IMAGE to run against (and keep) a specific flash image.
+ */
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "esp_littlefs.h"
+#include "esp_private/partition_linux.h"
+#include "esp_timer.h"
+
+#define MOUNT_PT "/littlefs"
+#define LABEL    "flash_test"
+
+static void check(esp_err_t err, const char *what)
+{
+    if (err != ESP_OK) {
+        printf("%s failed: %s\n", what, esp_err_to_name(err));
+        exit(1);
+    }
+}
+
+typedef struct {
+    int64_t wall_us;
+    uint64_t device_us;
+} phase_t;
+
+static void phase_start(phase_t *p)
+{
+    check(esp_littlefs_flash_sim_time(LABEL, NULL, true), "flash sim time");
+    check(esp_littlefs_io_stats(LABEL, NULL, true), "io stats");
+    p->wall_us = esp_timer_get_time();
+}
+
+static void phase_end(phase_t *p, const char *name)
+{
+    esp_littlefs_io_stats_t io;
+
+    p->wall_us = esp_timer_get_time() - p->wall_us;
+    check(esp_littlefs_flash_sim_time(LABEL, &p->device_us, false), "flash sim time");
+    check(esp_littlefs_io_stats(LABEL, &io, false), "io stats");
+    printf("%-28s wall %8" PRId64 " us, device %10" PRIu64 " us  (reads %" PRIu32 ", progs %" PRIu32 ", erases %" PRIu32 ")\n",
+           name, p->wall_us, p->device_us, io.read.count, io.prog.count, io.erase.count);
+}
+
+/* For libc calls, which report failures through errno */
+static void check_libc(int ok, const char *what)
+{
+    if (!ok) {
+        perror(what);
+        exit(1);
+    }
+}
+
+static void *xmalloc(size_t size)
+{
+    void *p = malloc(size);
+    check_libc(p != NULL, "malloc");
+    return p;
+}
+
+static int xopen(const char *path, int flags)
+{
+    int fd = open(path, flags, 0666);
+    check_libc(fd >= 0, path);
+    return fd;
+}
+
+static void xwrite(int fd, const void *buf, size_t size)
+{
+    check_libc(write(fd, buf, size) == (ssize_t)size, "write");
+}
+
+static void sequential_rw(size_t total, size_t chunk)
+{
+    phase_t p;
+    char name[64];
+    uint8_t *buf = xmalloc(chunk);
+    memset(buf, 0xA5, chunk);
+
+    phase_start(&p);
+    int fd = xopen(MOUNT_PT "/seq.bin", O_WRONLY | O_CREAT | O_TRUNC);
+    for (size_t n = 0; n < total; n += chunk) {
+        xwrite(fd, buf, chunk);
+    }
+    check_libc(close(fd) == 0, "close");
+    snprintf(name, sizeof(name), "write %uK in %u B chunks", (unsigned)(total / 1024), (unsigned)chunk);
+    phase_end(&p, name);
+
+    phase_start(&p);
+    fd = xopen(MOUNT_PT "/seq.bin", O_RDONLY);
+    size_t nread = 0;
+    ssize_t res;
+    while ((res = read(fd, buf, chunk)) > 0) {
+        nread += res;
+    }
+    check_libc(res == 0, "read");
+    if (nread != total) {
+        printf("read back %u of %u bytes\n", (unsigned)nread, (unsigned)total);
+        exit(1);
+    }
+    check_libc(close(fd) == 0, "close");
+    snprintf(name, sizeof(name), "read %uK in %u B chunks", (unsigned)(total / 1024), (unsigned)chunk);
+    phase_end(&p, name);
+
+    check_libc(unlink(MOUNT_PT "/seq.bin") == 0, "unlink");
+    free(buf);
+}
+
+static void small_files(int count)
+{
+    phase_t p;
+    char path[64];
+
+    phase_start(&p);
+    for (int i = 0; i < count; i++) {
+        snprintf(path, sizeof(path), MOUNT_PT "/f%03d.txt", i);
+        FILE *f = fopen(path, "w");
+        check_libc(f != NULL, path);
+        check_libc(fprintf(f, "file %d\n", i) > 0, "fprintf");
+        check_libc(fclose(f) == 0, "fclose");
+    }
+    phase_end(&p, "create small files");
+
+    phase_start(&p);
+    for (int i = 0; i < count; i++) {
+        snprintf(path, sizeof(path), MOUNT_PT "/f%03d.txt", i);
+        check_libc(unlink(path) == 0, path);
+    }
+    phase_end(&p, "delete small files");
+}
+
+static void random_pread(size_t total, size_t record, int count)
+{
+    phase_t p;
+    char name[64];
+    uint8_t *buf = xmalloc(4096);
+    uint32_t seed = 1;
+    memset(buf, 0x3C, 4096);
+
+    int fd = xopen(MOUNT_PT "/pread.bin", O_WRONLY | O_CREAT | O_TRUNC);
+    for (size_t n = 0; n < total; n += 4096) {
+        xwrite(fd, buf, 4096);
+    }
+    check_libc(close(fd) == 0, "close");
+
+    phase_start(&p);
+    fd = xopen(MOUNT_PT "/pread.bin", O_RDONLY);
+    for (int i = 0; i < count; i++) {
+        seed = seed * 1103515245 + 12345;
+        check_libc(pread(fd, buf, record, (seed >> 8) % (total - record)) == (ssize_t)record, "pread");
+    }
+    check_libc(close(fd) == 0, "close");
+    snprintf(name, sizeof(name), "%d random %u B preads", count, (unsigned)record);
+    phase_end(&p, name);
+
+    check_libc(unlink(MOUNT_PT "/pread.bin") == 0, "unlink");
+    free(buf);
+}
+
+uint32_t lfs_crc(uint32_t crc, const void *buffer, size_t size);
+
+static void crc_speed(size_t size)
+{
+    const size_t total = 64 * 1024 * 1024;
+    uint8_t *buf = xmalloc(size);
+    uint32_t crc = 0xffffffff;
+
+    for (size_t i = 0; i < size; i++) {
+        buf[i] = i * 31;
+    }
+    int64_t t = esp_timer_get_time();
+    for (size_t n = 0; n < total; n += size) {
+        crc = lfs_crc(crc, buf, size);
+    }
+    t = esp_timer_get_time() - t;
+    /* No cycle counter on the linux target, report time per byte instead */
+    printf("lfs_crc %5u B buffers       %8.3f ns/byte (crc %08" PRIx32 ")\n",
+           (unsigned)size, t * 1000.0 / total, crc);
+    free(buf);
+}
+
+void app_main(void)
+{
+    const char *image = getenv("LITTLEFS_FLASH_IMAGE");
+    if (image) {
+        esp_partition_file_mmap_ctrl_t *ctrl = esp_partition_get_file_mmap_ctrl_input();
+        strlcpy(ctrl->flash_file_name, image, sizeof(ctrl->flash_file_name));
+        ctrl->remove_dump = false;
+    }
+
+    const esp_vfs_littlefs_conf_t conf = {
+        .base_path = MOUNT_PT,
+        .partition_label = LABEL,
+        .format_if_mount_failed = true,
+    };
+    check(esp_littlefs_format(LABEL), "format");
+    check(esp_vfs_littlefs_register(&conf), "mount");
+
+    sequential_rw(256 * 1024, 512);
+    sequential_rw(256 * 1024, 4096);
+    small_files(100);
+    random_pread(512 * 1024, 64, 1000);
+    crc_speed(16);
+    crc_speed(4096);
+
+    check(esp_vfs_littlefs_unregister(LABEL), "unmount");
+    exit(0);
+}
@@ -7,8 +7,8 @@
 #include <stdbool.h>
 #include "esp_partition.h"
 
-/** LittleFS over ESP-IDF Block Device Layer (`esp_blockdev`) is only built on ESP-IDF 6+ (non-ESP8266). */
-#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(6, 0, 0) && !defined(ESP8266)
+/** LittleFS over ESP-IDF Block Device Layer (`esp_blockdev`) is only built on ESP-IDF 6+ (non-ESP8266, non-linux). */
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(6, 0, 0) && !defined(ESP8266) && !CONFIG_IDF_TARGET_LINUX
 #define ESP_LITTLEFS_HAS_BLOCKDEV 1
 #include "esp_blockdev.h"
 #else
@@ -37,6 +37,11 @@ extern "C" {
 #define ESP_LITTLEFS_ENABLE_FTRUNCATE
 #endif // CONFIG_VFS_SUPPORT_DIR
 
+#ifdef CONFIG_LITTLEFS_SDMMC_SUPPORT
+/** Value for esp_vfs_littlefs_conf_t::sdcard_block_size: derive the block size from the card's allocation unit. */
+#define ESP_LITTLEFS_SDMMC_BLOCK_SIZE_AUTO UINT32_MAX
+#endif
+
 /**
  *Configuration structure for esp_vfs_littlefs_register.
  */
@@ -49,6 +54,14 @@ typedef struct {
 
 #ifdef CONFIG_LITTLEFS_SDMMC_SUPPORT
     sdmmc_card_t *sdcard;       /**< SD card handle to use if both esp_partition handle & partition label is NULL */
+    /**
+     * LittleFS block size in bytes for `sdcard`; must be a multiple of the card's sector size.
+     * Grouping many sectors into one block shrinks the block count, so mount, lookahead scans and
+     * `esp_littlefs_sdmmc_info` scale with used data instead of card capacity.
+     * 0 uses CONFIG_LITTLEFS_SDMMC_BLOCK_SIZE; ESP_LITTLEFS_SDMMC_BLOCK_SIZE_AUTO picks it from the card.
+     * Must match the block size the card was formatted with.
+     */
+    uint32_t sdcard_block_size;
 #endif
 
 #if ESP_LITTLEFS_HAS_BLOCKDEV
@@ -70,10 +83,62 @@ typedef struct {
     esp_blockdev_handle_t blockdev;
 #endif
 
+#ifdef CONFIG_LITTLEFS_RAM_SUPPORT
+    /**
+     * Size in bytes of a RAM-backed filesystem, used when no other mount source is set.
+     * The block array is allocated at register time (see CONFIG_LITTLEFS_RAM_HEAP) and
+     * always starts out freshly formatted; it is freed on unregister.
+     * RAM-backed filesystems are identified by their `base_path`.
+     */
+    size_t ram_size;
+#endif
+
+    /**
+     * Maximum number of files open at once. If set, the file descriptor table and a pool of
+     * this many open files are allocated at mount time and open() never touches the heap;
+     * it fails with ENFILE when all are in use, and with ENAMETOOLONG if the path is longer
+     * than CONFIG_LITTLEFS_ARENA_PATH_LEN. 0 grows the table on demand. At most 65534.
+     */
+    uint16_t max_files;
+    /**
+     * Maximum number of directories open at once. If set, a pool of this many open
+     * directories is allocated at mount time and opendir() never touches the heap; it fails
+     * with ENFILE when all are in use. 0 allocates directories on demand.
+     */
+    uint16_t max_dirs;
+    /**
+     * Size in bytes of the read, prog and per-file caches of this mount. Larger caches
+     * speed up streaming large files, smaller ones make every open file cheaper.
+     * Must be a multiple of the read and prog sizes and a factor of the block size.
+     * 0 uses the default of the medium, at most CONFIG_LITTLEFS_CACHE_SIZE.
+     */
+    uint32_t cache_size;
+
+#ifdef CONFIG_LITTLEFS_OVERLAY
+    uint32_t overlay_interval_ms;     /**< Time between periodic checkpoints of the overlay, see `overlay`.
+                                           0 uses CONFIG_LITTLEFS_OVERLAY_INTERVAL_MS; at most an hour. */
+#endif
+#ifdef CONFIG_LITTLEFS_ARENA
+    uint16_t arena_files;             /**< File slots of the arena, see `arena`. 0 uses CONFIG_LITTLEFS_ARENA_FILES. */
+    uint16_t arena_dirs;              /**< Directory slots of the arena, see `arena`. 0 uses CONFIG_LITTLEFS_ARENA_DIRS. */
+#endif
+
     uint8_t format_if_mount_failed:1; /**< Format the file system if it fails to mount. */
     uint8_t read_only : 1;            /**< Mount the partition as read-only. */
     uint8_t dont_mount:1;             /**< Don't attempt to mount.*/
     uint8_t grow_on_mount:1;          /**< Grow filesystem to match partition size on mount.*/
+#ifdef CONFIG_LITTLEFS_PREERASE
+    uint8_t preerase:1;               /**< Keep free blocks erased ahead of time in a background task.
+                                           Flash partitions and classic-mode blockdevs only. */
+#endif
+#ifdef CONFIG_LITTLEFS_OVERLAY
+    uint8_t overlay:1;                /**< Keep writes in RAM and checkpoint them to flash periodically,
+                                           see CONFIG_LITTLEFS_OVERLAY. Flash partitions only. */
+#endif
+#ifdef CONFIG_LITTLEFS_ARENA
+    uint8_t arena:1;                  /**< Allocate open files, directories and littlefs buffers from a per-mount
+                                           arena reserved at mount time, see CONFIG_LITTLEFS_ARENA. */
+#endif
 } esp_vfs_littlefs_conf_t;
 
 /**
@@ -86,6 +151,7 @@ typedef struct {
  *          - ESP_ERR_NO_MEM          if objects could not be allocated
  *          - ESP_ERR_INVALID_STATE   if already mounted or partition is encrypted
  *          - ESP_ERR_NOT_FOUND       if partition for littlefs was not found
+ *          - ESP_ERR_INVALID_ARG     if a setting in `conf` is out of range
  *          - ESP_FAIL                if mount or format fails
  */
 esp_err_t esp_vfs_littlefs_register(const esp_vfs_littlefs_conf_t * conf);
@@ -140,6 +206,19 @@ esp_err_t esp_vfs_littlefs_unregister_partition(const esp_partition_t* partition
 esp_err_t esp_vfs_littlefs_unregister_blockdev(esp_blockdev_handle_t blockdev);
 #endif
 
+#ifdef CONFIG_LITTLEFS_RAM_SUPPORT
+/**
+ * Unregister and unmount a RAM-backed littlefs from VFS, freeing its contents.
+ *
+ * @param base_path  Mount point of the filesystem to unregister.
+ *
+ * @return
+ *          - ESP_OK if successful
+ *          - ESP_ERR_INVALID_STATE already unregistered
+ */
+esp_err_t esp_vfs_littlefs_unregister_ram(const char *base_path);
+#endif
+
 /**
  * Check if littlefs is mounted
  *
@@ -188,6 +267,19 @@ bool esp_littlefs_sdmmc_mounted(sdmmc_card_t *sdcard);
 bool esp_littlefs_blockdev_mounted(esp_blockdev_handle_t blockdev);
 #endif
 
+#ifdef CONFIG_LITTLEFS_RAM_SUPPORT
+/**
+ * Check if a RAM-backed littlefs is mounted
+ *
+ * @param base_path  Mount point of the filesystem to check.
+ *
+ * @return
+ *          - true    if mounted
+ *          - false   if not mounted
+ */
+bool esp_littlefs_ram_mounted(const char *base_path);
+#endif
+
 /**
  * Format the littlefs partition
  *
@@ -233,6 +325,19 @@ esp_err_t esp_littlefs_format_sdmmc(sdmmc_card_t *sdcard);
 esp_err_t esp_littlefs_format_blockdev(esp_blockdev_handle_t blockdev);
 #endif
 
+#ifdef CONFIG_LITTLEFS_RAM_SUPPORT
+/**
+ * Format a registered RAM-backed littlefs, deleting all files
+ *
+ * @param base_path  Mount point of the filesystem to format.
+ * @return
+ *          - ESP_OK                  if successful
+ *          - ESP_ERR_INVALID_STATE   if not registered
+ *          - ESP_FAIL                on error
+ */
+esp_err_t esp_littlefs_format_ram(const char *base_path);
+#endif
+
 /**
  * Get information for littlefs
  *
@@ -289,6 +394,434 @@ esp_err_t esp_littlefs_sdmmc_info(sdmmc_card_t *sdcard, size_t *total_bytes, siz
 esp_err_t esp_littlefs_blockdev_info(esp_blockdev_handle_t blockdev, size_t *total_bytes, size_t *used_bytes);
 #endif
 
+#ifdef CONFIG_LITTLEFS_RAM_SUPPORT
+/**
+ * Get information for a RAM-backed littlefs
+ *
+ * @param base_path                 Mount point of the filesystem to get info for.
+ * @param[out] total_bytes          Size of the file system
+ * @param[out] used_bytes           Current used bytes in the file system
+ *
+ * @return
+ *          - ESP_OK                  if success
+ *          - ESP_ERR_NOT_FOUND       if not registered
+ */
+esp_err_t esp_littlefs_ram_info(const char *base_path, size_t *total_bytes, size_t *used_bytes);
+#endif
+
+#ifdef CONFIG_LITTLEFS_ERASE_BLANK_CHECK
+/**
+ * Get the number of block erases skipped because the block was already blank
+ *
+ * @param partition_label           Optional, label of the partition to get info for.
+ * @param[out] erase_skipped        Number of skipped erases since mounting
+ *
+ * @return
+ *          - ESP_OK                  if success
+ *          - ESP_ERR_INVALID_STATE   if not mounted
+ */
+esp_err_t esp_littlefs_erase_skipped(const char* partition_label, uint32_t *erase_skipped);
+
+/**
+ * Get the number of block erases skipped because the block was already blank
+ *
+ * @param partition                 the partition to get info for.
+ * @param[out] erase_skipped        Number of skipped erases since mounting
+ *
+ * @return
+ *          - ESP_OK                  if success
+ *          - ESP_ERR_INVALID_STATE   if not mounted
+ */
+esp_err_t esp_littlefs_partition_erase_skipped(const esp_partition_t* partition, uint32_t *erase_skipped);
+#endif // CONFIG_LITTLEFS_ERASE_BLANK_CHECK
+
+#ifdef CONFIG_LITTLEFS_BLOCK_CACHE
+/**
+ * Block cache counters, see CONFIG_LITTLEFS_BLOCK_CACHE.
+ */
+typedef struct {
+    uint32_t hits;       /**< Block reads served from the cache */
+    uint32_t misses;     /**< Block reads that went to the storage device */
+    uint32_t writebacks; /**< Buffered writes flushed to the storage device */
+} esp_littlefs_block_cache_stats_t;
+
+/**
+ * Get block cache counters for littlefs
+ *
+ * @param partition_label           Optional, label of the partition to get info for.
+ * @param[out] stats                Block cache counters
+ * @param reset                     Reset the counters after reading them
+ *
+ * @return
+ *          - ESP_OK                  if success
+ *          - ESP_ERR_INVALID_STATE   if not mounted
+ */
+esp_err_t esp_littlefs_block_cache_stats(const char* partition_label, esp_littlefs_block_cache_stats_t *stats, bool reset);
+
+/**
+ * Get block cache counters for littlefs
+ *
+ * @param partition                 the partition to get info for.
+ * @param[out] stats                Block cache counters
+ * @param reset                     Reset the counters after reading them
+ *
+ * @return
+ *          - ESP_OK                  if success
+ *          - ESP_ERR_INVALID_STATE   if not mounted
+ */
+esp_err_t esp_littlefs_partition_block_cache_stats(const esp_partition_t* partition, esp_littlefs_block_cache_stats_t *stats, bool reset);
+
+#ifdef CONFIG_LITTLEFS_SDMMC_SUPPORT
+/**
+ * Get block cache counters for littlefs on SD card
+ *
+ * @param[in] sdcard                the SD card to get info for.
+ * @param[out] stats                Block cache counters
+ * @param reset                     Reset the counters after reading them
+ *
+ * @return
+ *          - ESP_OK                  if success
+ *          - ESP_ERR_INVALID_STATE   if not mounted
+ */
+esp_err_t esp_littlefs_sdmmc_block_cache_stats(sdmmc_card_t *sdcard, esp_littlefs_block_cache_stats_t *stats, bool reset);
+#endif
+
+#if ESP_LITTLEFS_HAS_BLOCKDEV
+/**
+ * Get block cache counters for littlefs
+ *
+ * @param blockdev                  the blockdev to get info for.
+ * @param[out] stats                Block cache counters
+ * @param reset                     Reset the counters after reading them
+ *
+ * @return
+ *          - ESP_OK                  if success
+ *          - ESP_ERR_INVALID_STATE   if not mounted
+ */
+esp_err_t esp_littlefs_blockdev_block_cache_stats(esp_blockdev_handle_t blockdev, esp_littlefs_block_cache_stats_t *stats, bool reset);
+#endif
+#endif // CONFIG_LITTLEFS_BLOCK_CACHE
+
+#ifdef CONFIG_LITTLEFS_IO_STATS
+/** Number of buckets in esp_littlefs_io_op_stats_t::hist */
+#define ESP_LITTLEFS_IO_STATS_HIST_BUCKETS 8
+
+/**
+ * Counters for one kind of block device operation, see CONFIG_LITTLEFS_IO_STATS.
+ */
+typedef struct {
+    uint32_t count;     /**< Number of calls */
+    uint64_t bytes;     /**< Bytes read/programmed/erased; 0 for sync */
+    uint64_t total_us;  /**< Cumulative latency */
+    uint32_t max_us;    /**< Highest latency of a single call */
+    uint32_t errors;    /**< Calls that returned an error */
+    uint32_t hist[ESP_LITTLEFS_IO_STATS_HIST_BUCKETS]; /**< Latency histogram; bucket 0 counts calls under 16us,
+                                                            each next bucket covers 4x longer calls, the last one everything from 256ms */
+} esp_littlefs_io_op_stats_t;
+
+/**
+ * Block device operations issued by littlefs, and erases by the pre-erase task,
+ * since mounting (or the last reset).
+ */
+typedef struct {
+    esp_littlefs_io_op_stats_t read;
+    esp_littlefs_io_op_stats_t prog;
+    esp_littlefs_io_op_stats_t erase;
+    esp_littlefs_io_op_stats_t sync;
+} esp_littlefs_io_stats_t;
+
+/**
+ * Get the block device I/O counters of a littlefs mount
+ *
+ * @param partition_label           Optional, label of the partition to get info for.
+ * @param[out] stats                Optional, I/O counters
+ * @param reset                     Reset the counters after reading them
+ *
+ * @return
+ *          - ESP_OK                  if success
+ *          - ESP_ERR_INVALID_STATE   if not mounted
+ */
+esp_err_t esp_littlefs_io_stats(const char* partition_label, esp_littlefs_io_stats_t *stats, bool reset);
+
+/**
+ * Get the block device I/O counters of a littlefs mount
+ *
+ * @param partition                 the partition to get info for.
+ * @param[out] stats                Optional, I/O counters
+ * @param reset                     Reset the counters after reading them
+ *
+ * @return
+ *          - ESP_OK                  if success
+ *          - ESP_ERR_INVALID_STATE   if not mounted
+ */
+esp_err_t esp_littlefs_partition_io_stats(const esp_partition_t* partition, esp_littlefs_io_stats_t *stats, bool reset);
+
+#ifdef CONFIG_LITTLEFS_SDMMC_SUPPORT
+/**
+ * Get the block device I/O counters of a littlefs mount
+ *
+ * @param[in] sdcard                the SD card to get info for.
+ * @param[out] stats                Optional, I/O counters
+ * @param reset                     Reset the counters after reading them
+ *
+ * @return
+ *          - ESP_OK                  if success
+ *          - ESP_ERR_INVALID_STATE   if not mounted
+ */
+esp_err_t esp_littlefs_sdmmc_io_stats(sdmmc_card_t *sdcard, esp_littlefs_io_stats_t *stats, bool reset);
+#endif
+
+#if ESP_LITTLEFS_HAS_BLOCKDEV
+/**
+ * Get the block device I/O counters of a littlefs mount
+ *
+ * @param blockdev                  the blockdev to get info for.
+ * @param[out] stats                Optional, I/O counters
+ * @param reset                     Reset the counters after reading them
+ *
+ * @return
+ *          - ESP_OK                  if success
+ *          - ESP_ERR_INVALID_STATE   if not mounted
+ */
+esp_err_t esp_littlefs_blockdev_io_stats(esp_blockdev_handle_t blockdev, esp_littlefs_io_stats_t *stats, bool reset);
+#endif
+#endif // CONFIG_LITTLEFS_IO_STATS
+
+#ifdef CONFIG_LITTLEFS_WEAR_TRACKING
+/** Number of buckets in esp_littlefs_wear_stats_t::hist */
+#define ESP_LITTLEFS_WEAR_HIST_BUCKETS 8
+
+/**
+ * Per-block erase count summary, see CONFIG_LITTLEFS_WEAR_TRACKING.
+ */
+typedef struct {
+    uint32_t blocks;     /**< Number of blocks tracked; 0 if wear isn't tracked for this mount */
+    uint64_t total;      /**< Sum of all erase counts */
+    uint32_t min;        /**< Lowest erase count of any block */
+    uint32_t max;        /**< Highest erase count of any block */
+    uint32_t mean;       /**< Average erase count, rounded down */
+    uint32_t hist_min;   /**< Erase count at the start of hist[0] */
+    uint32_t hist_width; /**< Range of erase counts covered by each bucket */
+    uint32_t hist[ESP_LITTLEFS_WEAR_HIST_BUCKETS]; /**< Number of blocks per erase count range; bucket i counts blocks
+                                                        erased [hist_min + i*hist_width, hist_min + (i+1)*hist_width) times */
+} esp_littlefs_wear_stats_t;
+
+/**
+ * Get the per-block erase count summary of a littlefs mount
+ *
+ * @param partition_label           Optional, label of the partition to get info for.
+ * @param[out] stats                Erase count summary
+ *
+ * @return
+ *          - ESP_OK                  if success
+ *          - ESP_ERR_INVALID_STATE   if not mounted
+ */
+esp_err_t esp_littlefs_wear_stats(const char* partition_label, esp_littlefs_wear_stats_t *stats);
+
+/**
+ * Get the per-block erase count summary of a littlefs mount
+ *
+ * @param partition                 the partition to get info for.
+ * @param[out] stats                Erase count summary
+ *
+ * @return
+ *          - ESP_OK                  if success
+ *          - ESP_ERR_INVALID_STATE   if not mounted
+ */
+esp_err_t esp_littlefs_partition_wear_stats(const esp_partition_t* partition, esp_littlefs_wear_stats_t *stats);
+
+#ifdef CONFIG_LITTLEFS_SDMMC_SUPPORT
+/**
+ * Get the per-block erase count summary of a littlefs mount
+ *
+ * @param[in] sdcard                the SD card to get info for.
+ * @param[out] stats                Erase count summary
+ *
+ * @return
+ *          - ESP_OK                  if success
+ *          - ESP_ERR_INVALID_STATE   if not mounted
+ */
+esp_err_t esp_littlefs_sdmmc_wear_stats(sdmmc_card_t *sdcard, esp_littlefs_wear_stats_t *stats);
+#endif
+
+#if ESP_LITTLEFS_HAS_BLOCKDEV
+/**
+ * Get the per-block erase count summary of a littlefs mount
+ *
+ * @param blockdev                  the blockdev to get info for.
+ * @param[out] stats                Erase count summary
+ *
+ * @return
+ *          - ESP_OK                  if success
+ *          - ESP_ERR_INVALID_STATE   if not mounted
+ */
+esp_err_t esp_littlefs_blockdev_wear_stats(esp_blockdev_handle_t blockdev, esp_littlefs_wear_stats_t *stats);
+#endif
+#endif // CONFIG_LITTLEFS_WEAR_TRACKING
+
+#ifdef CONFIG_LITTLEFS_FLASH_SIM
+/**
+ * Get the device time modelled by the flash timing model, see CONFIG_LITTLEFS_FLASH_SIM.
+ *
+ * @param partition_label           Optional, label of the partition to get info for.
+ * @param[out] time_us              Modelled read/prog/erase time since mounting (or the last reset), in microseconds
+ * @param reset                     Reset the modelled time after reading it
+ *
+ * @return
+ *          - ESP_OK                  if success
+ *          - ESP_ERR_INVALID_STATE   if not mounted
+ */
+esp_err_t esp_littlefs_flash_sim_time(const char* partition_label, uint64_t *time_us, bool reset);
+
+/**
+ * Get the device time modelled by the flash timing model, see CONFIG_LITTLEFS_FLASH_SIM.
+ *
+ * @param partition                 the partition to get info for.
+ * @param[out] time_us              Modelled read/prog/erase time since mounting (or the last reset), in microseconds
+ * @param reset                     Reset the modelled time after reading it
+ *
+ * @return
+ *          - ESP_OK                  if success
+ *          - ESP_ERR_INVALID_STATE   if not mounted
+ */
+esp_err_t esp_littlefs_partition_flash_sim_time(const esp_partition_t* partition, uint64_t *time_us, bool reset);
+#endif // CONFIG_LITTLEFS_FLASH_SIM
+
+#ifdef CONFIG_LITTLEFS_OVERLAY
+/**
+ * Write the changes held by the RAM write overlay to flash now, see CONFIG_LITTLEFS_OVERLAY.
+ *
+ * Returns once the checkpoint is on flash.
+ *
+ * @param partition_label           Optional, label of the partition to checkpoint.
+ *
+ * @return
+ *          - ESP_OK                  if success
+ *          - ESP_ERR_NOT_FOUND       if not mounted
+ *          - ESP_ERR_INVALID_STATE   if the mount has no overlay
+ *          - ESP_FAIL                if writing to flash failed
+ */
+esp_err_t esp_littlefs_checkpoint(const char* partition_label);
+
+/**
+ * Write the changes held by the RAM write overlay to flash now, see CONFIG_LITTLEFS_OVERLAY.
+ *
+ * Returns once the checkpoint is on flash.
+ *
+ * @param partition                 the partition to checkpoint.
+ *
+ * @return
+ *          - ESP_OK                  if success
+ *          - ESP_ERR_NOT_FOUND       if not mounted
+ *          - ESP_ERR_INVALID_STATE   if the mount has no overlay
+ *          - ESP_FAIL                if writing to flash failed
+ */
+esp_err_t esp_littlefs_partition_checkpoint(const esp_partition_t* partition);
+#endif // CONFIG_LITTLEFS_OVERLAY
+
+/**
+ * Usage of one size class of a per-mount arena, see `max_files`, `max_dirs` and CONFIG_LITTLEFS_ARENA.
+ */
+typedef struct {
+    uint32_t slots;      /**< Number of slots */
+    uint32_t slot_size;  /**< Bytes per slot */
+    uint32_t in_use;     /**< Slots currently allocated */
+    uint32_t high_water; /**< Most slots allocated at once since mounting */
+    uint32_t fallbacks;  /**< Allocations served from the heap because all slots were in use or the object didn't fit.
+                              Always 0 for the `max_files` and `max_dirs` pools, which never fall back. */
+} esp_littlefs_arena_class_stats_t;
+
+/**
+ * Usage of a per-mount arena.
+ */
+typedef struct {
+    size_t size;                                /**< Bytes reserved for the arena; 0 if the mount doesn't use one */
+    esp_littlefs_arena_class_stats_t file;      /**< Open files */
+    esp_littlefs_arena_class_stats_t dir;       /**< Open directories */
+    esp_littlefs_arena_class_stats_t cache;     /**< littlefs read and prog caches */
+    esp_littlefs_arena_class_stats_t lookahead; /**< littlefs lookahead buffer */
+} esp_littlefs_arena_stats_t;
+
+/**
+ * Get the arena usage of a littlefs mount
+ *
+ * @param partition_label           Optional, label of the partition to get info for.
+ * @param[out] stats                Arena usage
+ *
+ * @return
+ *          - ESP_OK                  if success
+ *          - ESP_ERR_INVALID_STATE   if not mounted
+ */
+esp_err_t esp_littlefs_arena_stats(const char* partition_label, esp_littlefs_arena_stats_t *stats);
+
+/**
+ * Get the arena usage of a littlefs mount
+ *
+ * @param partition                 the partition to get info for.
+ * @param[out] stats                Arena usage
+ *
+ * @return
+ *          - ESP_OK                  if success
+ *          - ESP_ERR_INVALID_STATE   if not mounted
+ */
+esp_err_t esp_littlefs_partition_arena_stats(const esp_partition_t* partition, esp_littlefs_arena_stats_t *stats);
+
+#ifdef CONFIG_LITTLEFS_SDMMC_SUPPORT
+/**
+ * Get the arena usage of a littlefs mount
+ *
+ * @param[in] sdcard                the SD card to get info for.
+ * @param[out] stats                Arena usage
+ *
+ * @return
+ *          - ESP_OK                  if success
+ *          - ESP_ERR_INVALID_STATE   if not mounted
+ */
+esp_err_t esp_littlefs_sdmmc_arena_stats(sdmmc_card_t *sdcard, esp_littlefs_arena_stats_t *stats);
+#endif
+
+#if ESP_LITTLEFS_HAS_BLOCKDEV
+/**
+ * Get the arena usage of a littlefs mount
+ *
+ * @param blockdev                  the blockdev to get info for.
+ * @param[out] stats                Arena usage
+ *
+ * @return
+ *          - ESP_OK                  if success
+ *          - ESP_ERR_INVALID_STATE   if not mounted
+ */
+esp_err_t esp_littlefs_blockdev_arena_stats(esp_blockdev_handle_t blockdev, esp_littlefs_arena_stats_t *stats);
+#endif
+
+#if ESP_LITTLEFS_HAS_BLOCKDEV && defined(CONFIG_LITTLEFS_STRIPE)
+/**
+ * Create a block device that stripes across two others, see CONFIG_LITTLEFS_STRIPE.
+ *
+ * The address space alternates between the members every `stripe_size` bytes, and one
+ * erase unit of the striped device covers a stripe on each member. Requests that span
+ * both members are issued to them in parallel. Pass the handle as
+ * esp_vfs_littlefs_conf_t::blockdev to mount it.
+ *
+ * Both members must report the same device flags. The striped device takes ownership of
+ * them: its `ops->release` (called on unregister) releases both members too.
+ *
+ * @param dev0                      First member; holds the even stripes.
+ * @param dev1                      Second member; holds the odd stripes.
+ * @param stripe_size               Bytes per stripe, a multiple of both members' erase, read
+ *                                  and write sizes. 0 picks the smallest valid size.
+ * @param[out] out                  The striped block device.
+ *
+ * @return
+ *          - ESP_OK                  if success
+ *          - ESP_ERR_INVALID_ARG     if the members' geometry can't be striped with `stripe_size`
+ *          - ESP_ERR_NOT_SUPPORTED   if the members' device flags differ
+ *          - ESP_ERR_NO_MEM          if the device or its worker task couldn't be allocated
+ */
+esp_err_t esp_littlefs_stripe_bdl_create(esp_blockdev_handle_t dev0, esp_blockdev_handle_t dev1,
+                                         size_t stripe_size, esp_blockdev_handle_t *out);
+#endif
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -19,10 +19,12 @@
 #include "littlefs_api.h"
 #include <inttypes.h>
 #include <dirent.h>
+#if !CONFIG_IDF_TARGET_LINUX
 #include <sys/dirent.h>
+#include <sys/lock.h>
+#endif
 #include <sys/errno.h>
 #include <sys/fcntl.h>
-#include <sys/lock.h>
 #include <sys/param.h>
 #include <time.h>
 #include <unistd.h>
@@ -35,17 +37,19 @@
 
 #ifdef CONFIG_LITTLEFS_SDMMC_SUPPORT
 #include <sdmmc_cmd.h>
+#include "esp_heap_caps.h"
 #endif
 
+#if !CONFIG_IDF_TARGET_LINUX
 #include "spi_flash_mmap.h"
 #include "esp_rom_spiflash.h"
+#endif
 
 #define CONFIG_LITTLEFS_BLOCK_SIZE 4096 /* ESP32 can only operate at 4kb */
 
 /* File Descriptor Caching Params */
 #define CONFIG_LITTLEFS_FD_CACHE_REALLOC_FACTOR 2  /* Amount to resize FD cache by */
 #define CONFIG_LITTLEFS_FD_CACHE_MIN_SIZE 4  /* Minimum size of FD cache */
-#define CONFIG_LITTLEFS_FD_CACHE_HYST 4  /* When shrinking, leave this many trailing FD slots available */
 
 /**
  * @brief Last Modified Time
@@ -69,17 +73,6 @@
 
 #define LFS_MIN_BLOCK_SIZE 128 /* Enforced by LFS_ASSERT in lfs_init */
 
-/**
- * @brief littlefs DIR structure
- */
-typedef struct {
-    DIR dir;            /*!< VFS DIR struct */
-    lfs_dir_t d;        /*!< littlefs DIR struct */
-    struct dirent e;    /*!< Last open dirent */
-    long offset;        /*!< Offset of the current dirent */
-    char *path;         /*!< Requested directory name */
-} vfs_littlefs_dir_t;
-
 static int       vfs_littlefs_open(void* ctx, const char * path, int flags, int mode);
 static ssize_t   vfs_littlefs_write(void* ctx, int fd, const void * data, size_t size);
 static ssize_t   vfs_littlefs_read(void* ctx, int fd, void * dst, size_t size);
@@ -111,7 +104,7 @@ static ssize_t vfs_littlefs_truncate( void *ctx, const char *path, off_t size);
 static int vfs_littlefs_ftruncate(void *ctx, int fd, off_t size);
 #endif // ESP_LITTLEFS_ENABLE_FTRUNCATE
 
-static void      esp_littlefs_dir_free(vfs_littlefs_dir_t *dir);
+static void      esp_littlefs_dir_free(esp_littlefs_t *efs, vfs_littlefs_dir_t *dir);
 #endif
 
 static void      esp_littlefs_take_efs_lock(void);
@@ -129,6 +122,11 @@ static int esp_littlefs_file_sync(esp_littlefs_t *efs, vfs_littlefs_file_t *file
 static esp_err_t esp_littlefs_by_sdmmc_handle(sdmmc_card_t *handle, int *index);
 #endif
 
+#ifdef CONFIG_LITTLEFS_RAM_SUPPORT
+static esp_err_t esp_littlefs_by_ram(const char *base_path, int *index);
+static esp_err_t esp_littlefs_init_ram(esp_littlefs_t** efs, size_t size, bool read_only);
+#endif
+
 static esp_err_t esp_littlefs_get_empty(int *index);
 static void      esp_littlefs_free(esp_littlefs_t ** efs);
 static int       esp_littlefs_flags_conv(int m);
@@ -177,29 +175,64 @@ static esp_littlefs_t * _efs[CONFIG_LITTLEFS_MAX_PARTITIONS] = { 0 };
 static const char * esp_littlefs_errno(enum lfs_error lfs_errno);
 #endif
 
-static inline void * esp_littlefs_calloc(size_t __nmemb, size_t __size) {
-    /* Used internally by this wrapper only */
-#if defined(CONFIG_LITTLEFS_MALLOC_STRATEGY_INTERNAL)
-    return heap_caps_calloc(__nmemb, __size, MALLOC_CAP_8BIT | MALLOC_CAP_INTERNAL);
-#elif defined(CONFIG_LITTLEFS_MALLOC_STRATEGY_SPIRAM)
-    return heap_caps_calloc(__nmemb, __size, MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM);
-#elif defined(CONFIG_LITTLEFS_MALLOC_STRATEGY_SPIRAM_PREFER)
-    return heap_caps_calloc_prefer(__nmemb, __size, 2, MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM, MALLOC_CAP_8BIT | MALLOC_CAP_DEFAULT);
-#else /* CONFIG_LITTLEFS_MALLOC_STRATEGY_DISABLE, CONFIG_LITTLEFS_MALLOC_STRATEGY_DEFAULT or not defined */
-    return calloc(__nmemb, __size);
-#endif
+/**
+ * @brief Get an open file by file descriptor.
+ * @return the file, or NULL if fd isn't open.
+ * @warning This must be called with lock taken
+ */
+static inline vfs_littlefs_file_t * esp_littlefs_get_file(esp_littlefs_t *efs, int fd) {
+    if ((uint32_t)fd >= efs->cache_size || (efs->cache[fd].free & ESP_LITTLEFS_FD_FREE)) {
+        return NULL;
+    }
+    return efs->cache[fd].file;
+}
+
+/**
+ * @brief Grow the file descriptor table, adding the new entries to the free list.
+ * @return false if the table could not be realloced.
+ */
+static bool esp_littlefs_grow_fds(esp_littlefs_t *efs, uint16_t new_size) {
+    if (new_size <= efs->cache_size) {
+        return false;
+    }
+    esp_littlefs_fd_t * new_cache = realloc(efs->cache, new_size * sizeof(*efs->cache));
+    if (!new_cache) {
+        return false;
+    }
+    /* Push the new entries in reverse, so the lowest one is handed out first */
+    for (uint16_t i = new_size; i-- > efs->cache_size; ) {
+        new_cache[i].free = ((uintptr_t)efs->fd_free << 1) | ESP_LITTLEFS_FD_FREE;
+        efs->fd_free = i;
+    }
+    efs->cache = new_cache;
+    efs->cache_size = new_size;
+    return true;
+}
+
+/**
+ * @brief Set up the file descriptor table of a freshly mounted filesystem.
+ * @return ESP_OK on success, ESP_ERR_NO_MEM otherwise.
+ */
+static esp_err_t esp_littlefs_init_fds(esp_littlefs_t * efs) {
+    efs->cache = NULL;
+    efs->cache_size = efs->fd_count = 0;
+    efs->fd_free = ESP_LITTLEFS_FD_NONE;
+    if (!esp_littlefs_grow_fds(efs, efs->max_files ? efs->max_files : CONFIG_LITTLEFS_FD_CACHE_MIN_SIZE)) {
+        ESP_LOGE(ESP_LITTLEFS_TAG, "Unable to allocate file cache");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
 }
 
 static void esp_littlefs_free_fds(esp_littlefs_t * efs) {
     /* Need to free all files that were opened */
-    while (efs->file) {
-        vfs_littlefs_file_t * next = efs->file->next;
-        free(efs->file);
-        efs->file = next;
+    for (uint16_t i = 0; i < efs->cache_size; i++) {
+        esp_littlefs_arena_free(efs, esp_littlefs_get_file(efs, i));
     }
     free(efs->cache);
     efs->cache = 0;
     efs->cache_size = efs->fd_count = 0;
+    efs->fd_free = ESP_LITTLEFS_FD_NONE;
 }
 
 static int lfs_errno_remap(enum lfs_error err) {
@@ -226,7 +259,15 @@ static int lfs_errno_remap(enum lfs_error err) {
 esp_err_t format_from_efs(esp_littlefs_t *efs)
 {
     assert( efs );
+    esp_err_t err = ESP_OK;
     bool was_mounted = false;
+    bool unmounted = false;
+
+#ifdef CONFIG_LITTLEFS_PREERASE
+    /* Keep the pre-erase task off the media while it's reformatted; restarted on exit */
+    int (*preerase_fn)(const struct lfs_config *c, lfs_block_t block) = efs->preerase.task ? efs->preerase.erase : NULL;
+    esp_littlefs_preerase_stop(efs);
+#endif
 
     /* Unmount if mounted */
     if(efs->cache_size > 0){
@@ -236,18 +277,25 @@ esp_err_t format_from_efs(esp_littlefs_t *efs)
         res = lfs_unmount(efs->fs);
         if(res != LFS_ERR_OK){
             ESP_LOGE(ESP_LITTLEFS_TAG, "Failed to unmount.");
-            return ESP_FAIL;
+            err = ESP_FAIL;
+            goto exit;
         }
+        unmounted = true;
         esp_littlefs_free_fds(efs);
     }
 
+#ifdef CONFIG_LITTLEFS_BLOCK_CACHE
+    /* Cached contents won't survive the format */
+    esp_littlefs_block_cache_invalidate(efs);
+#endif
+
 #ifdef CONFIG_LITTLEFS_SDMMC_SUPPORT
     /* Format the SD card too */
     if (efs->sdcard) {
-        esp_err_t ret = sdmmc_full_erase(efs->sdcard);
-        if (ret != ESP_OK) {
-            ESP_LOGE(ESP_LITTLEFS_TAG, "Failed to format SD card: 0x%x %s", ret, esp_err_to_name(ret));
-            return ret;
+        err = sdmmc_full_erase(efs->sdcard);
+        if (err != ESP_OK) {
+            ESP_LOGE(ESP_LITTLEFS_TAG, "Failed to format SD card: 0x%x %s", err, esp_err_to_name(err));
+            goto exit;
         }
 
         ESP_LOGI(ESP_LITTLEFS_TAG, "SD card formatted!");
@@ -265,6 +313,17 @@ esp_err_t format_from_efs(esp_littlefs_t *efs)
             res = lfs_format(efs->fs, &efs->cfg);
         } else
 #endif
+#ifdef CONFIG_LITTLEFS_RAM_SUPPORT
+        if (efs->ram) {
+            res = lfs_format(efs->fs, &efs->cfg);
+        } else
+#endif
+#ifdef CONFIG_LITTLEFS_OVERLAY
+        if (efs->overlay.journal) {
+            /* block_count already stops short of the journal */
+            res = lfs_format(efs->fs, &efs->cfg);
+        } else
+#endif
 #if ESP_LITTLEFS_HAS_BLOCKDEV
         if (efs->bdl_handle) {
             const esp_blockdev_geometry_t *g = &efs->bdl_handle->geometry;
@@ -280,7 +339,8 @@ esp_err_t format_from_efs(esp_littlefs_t *efs)
 
         if( res != LFS_ERR_OK ) {
             ESP_LOGE(ESP_LITTLEFS_TAG, "Failed to format filesystem");
-            return ESP_FAIL;
+            err = ESP_FAIL;
+            goto exit;
         }
     }
 
@@ -292,14 +352,29 @@ esp_err_t format_from_efs(esp_littlefs_t *efs)
         res = lfs_mount(efs->fs, &efs->cfg);
         if( res != LFS_ERR_OK ) {
             ESP_LOGE(ESP_LITTLEFS_TAG, "Failed to re-mount filesystem");
-            return ESP_FAIL;
+            err = ESP_FAIL;
+            goto exit;
         }
-        efs->cache_size = CONFIG_LITTLEFS_FD_CACHE_MIN_SIZE;  // Initial size of cache; will resize ondemand
-        efs->cache = esp_littlefs_calloc(efs->cache_size, sizeof(*efs->cache));
+        if (esp_littlefs_init_fds(efs) != ESP_OK) {  // Initial size of the table; will resize ondemand
+            lfs_unmount(efs->fs);
+            err = ESP_ERR_NO_MEM;
+            goto exit;
+        }
+        unmounted = false;
     }
     ESP_LOGV(ESP_LITTLEFS_TAG, "Format Success!");
 
-    return ESP_OK;
+exit:
+#ifdef CONFIG_LITTLEFS_PREERASE
+    /* Whatever failed, a filesystem that's still mounted gets its pre-erase task back.
+     * One left unmounted has nothing to pre-erase until it's registered again. */
+    if (preerase_fn && !unmounted) {
+        esp_littlefs_preerase_start(efs, preerase_fn);
+    }
+#else
+    (void)unmounted;
+#endif
+    return err;
 }
 
 void get_total_and_used_bytes(esp_littlefs_t *efs, size_t *total_bytes, size_t *used_bytes) {
@@ -357,6 +432,17 @@ bool esp_littlefs_blockdev_mounted(esp_blockdev_handle_t blockdev)
 }
 #endif
 
+#ifdef CONFIG_LITTLEFS_RAM_SUPPORT
+bool esp_littlefs_ram_mounted(const char *base_path)
+{
+    int index;
+    esp_err_t err = esp_littlefs_by_ram(base_path, &index);
+
+    if (err != ESP_OK) return false;
+    return _efs[index]->cache_size > 0;
+}
+#endif
+
 esp_err_t esp_littlefs_info(const char* partition_label, size_t *total_bytes, size_t *used_bytes){
     int index;
     esp_err_t err;
@@ -407,6 +493,359 @@ esp_err_t esp_littlefs_blockdev_info(esp_blockdev_handle_t blockdev, size_t *tot
 }
 #endif
 
+#ifdef CONFIG_LITTLEFS_RAM_SUPPORT
+esp_err_t esp_littlefs_ram_info(const char *base_path, size_t *total_bytes, size_t *used_bytes)
+{
+    int index;
+    esp_err_t err;
+
+    err = esp_littlefs_by_ram(base_path, &index);
+    if (err != ESP_OK) return err;
+    get_total_and_used_bytes(_efs[index], total_bytes, used_bytes);
+
+    return ESP_OK;
+}
+#endif
+
+#ifdef CONFIG_LITTLEFS_ERASE_BLANK_CHECK
+esp_err_t esp_littlefs_erase_skipped(const char* partition_label, uint32_t *erase_skipped){
+    int index;
+    esp_err_t err;
+
+    err = esp_littlefs_by_label(partition_label, &index);
+    if(err != ESP_OK) return err;
+    sem_take(_efs[index]);
+    *erase_skipped = _efs[index]->erase_skipped;
+    sem_give(_efs[index]);
+
+    return ESP_OK;
+}
+
+esp_err_t esp_littlefs_partition_erase_skipped(const esp_partition_t* partition, uint32_t *erase_skipped){
+    int index;
+    esp_err_t err;
+
+    err = esp_littlefs_by_partition(partition, &index);
+    if(err != ESP_OK) return err;
+    sem_take(_efs[index]);
+    *erase_skipped = _efs[index]->erase_skipped;
+    sem_give(_efs[index]);
+
+    return ESP_OK;
+}
+#endif // CONFIG_LITTLEFS_ERASE_BLANK_CHECK
+
+#ifdef CONFIG_LITTLEFS_BLOCK_CACHE
+static void get_block_cache_stats(esp_littlefs_t *efs, esp_littlefs_block_cache_stats_t *stats, bool reset) {
+    sem_take(efs);
+    if(stats) {
+        stats->hits = efs->bcache.hits;
+        stats->misses = efs->bcache.misses;
+        stats->writebacks = efs->bcache.writebacks;
+    }
+    if(reset) {
+        efs->bcache.hits = 0;
+        efs->bcache.misses = 0;
+        efs->bcache.writebacks = 0;
+    }
+    sem_give(efs);
+}
+
+esp_err_t esp_littlefs_block_cache_stats(const char* partition_label, esp_littlefs_block_cache_stats_t *stats, bool reset){
+    int index;
+    esp_err_t err;
+
+    err = esp_littlefs_by_label(partition_label, &index);
+    if(err != ESP_OK) return err;
+    get_block_cache_stats(_efs[index], stats, reset);
+
+    return ESP_OK;
+}
+
+esp_err_t esp_littlefs_partition_block_cache_stats(const esp_partition_t* partition, esp_littlefs_block_cache_stats_t *stats, bool reset){
+    int index;
+    esp_err_t err;
+
+    err = esp_littlefs_by_partition(partition, &index);
+    if(err != ESP_OK) return err;
+    get_block_cache_stats(_efs[index], stats, reset);
+
+    return ESP_OK;
+}
+
+#ifdef CONFIG_LITTLEFS_SDMMC_SUPPORT
+esp_err_t esp_littlefs_sdmmc_block_cache_stats(sdmmc_card_t *sdcard, esp_littlefs_block_cache_stats_t *stats, bool reset)
+{
+    int index;
+    esp_err_t err;
+
+    err = esp_littlefs_by_sdmmc_handle(sdcard, &index);
+    if(err != ESP_OK) return err;
+    get_block_cache_stats(_efs[index], stats, reset);
+
+    return ESP_OK;
+}
+#endif
+
+#if ESP_LITTLEFS_HAS_BLOCKDEV
+esp_err_t esp_littlefs_blockdev_block_cache_stats(esp_blockdev_handle_t blockdev, esp_littlefs_block_cache_stats_t *stats, bool reset)
+{
+    int index;
+    esp_err_t err;
+
+    err = esp_littlefs_by_blockdev(blockdev, &index);
+    if (err != ESP_OK) return err;
+    get_block_cache_stats(_efs[index], stats, reset);
+
+    return ESP_OK;
+}
+#endif
+#endif // CONFIG_LITTLEFS_BLOCK_CACHE
+
+#ifdef CONFIG_LITTLEFS_IO_STATS
+static void get_io_stats(esp_littlefs_t *efs, esp_littlefs_io_stats_t *stats, bool reset) {
+    sem_take(efs);
+    if(stats) *stats = efs->io_stats.stats;
+    if(reset) memset(&efs->io_stats.stats, 0, sizeof(efs->io_stats.stats));
+    sem_give(efs);
+}
+
+esp_err_t esp_littlefs_io_stats(const char* partition_label, esp_littlefs_io_stats_t *stats, bool reset)
+{
+    int index;
+    esp_err_t err;
+
+    err = esp_littlefs_by_label(partition_label, &index);
+    if(err != ESP_OK) return err;
+    get_io_stats(_efs[index], stats, reset);
+
+    return ESP_OK;
+}
+
+esp_err_t esp_littlefs_partition_io_stats(const esp_partition_t* partition, esp_littlefs_io_stats_t *stats, bool reset)
+{
+    int index;
+    esp_err_t err;
+
+    err = esp_littlefs_by_partition(partition, &index);
+    if(err != ESP_OK) return err;
+    get_io_stats(_efs[index], stats, reset);
+
+    return ESP_OK;
+}
+
+#ifdef CONFIG_LITTLEFS_SDMMC_SUPPORT
+esp_err_t esp_littlefs_sdmmc_io_stats(sdmmc_card_t *sdcard, esp_littlefs_io_stats_t *stats, bool reset)
+{
+    int index;
+    esp_err_t err;
+
+    err = esp_littlefs_by_sdmmc_handle(sdcard, &index);
+    if(err != ESP_OK) return err;
+    get_io_stats(_efs[index], stats, reset);
+
+    return ESP_OK;
+}
+#endif
+
+#if ESP_LITTLEFS_HAS_BLOCKDEV
+esp_err_t esp_littlefs_blockdev_io_stats(esp_blockdev_handle_t blockdev, esp_littlefs_io_stats_t *stats, bool reset)
+{
+    int index;
+    esp_err_t err;
+
+    err = esp_littlefs_by_blockdev(blockdev, &index);
+    if(err != ESP_OK) return err;
+    get_io_stats(_efs[index], stats, reset);
+
+    return ESP_OK;
+}
+#endif
+#endif // CONFIG_LITTLEFS_IO_STATS
+
+#ifdef CONFIG_LITTLEFS_WEAR_TRACKING
+static void get_wear_stats(esp_littlefs_t *efs, esp_littlefs_wear_stats_t *stats) {
+    sem_take(efs);
+    esp_littlefs_wear_get_stats(efs, stats);
+    sem_give(efs);
+}
+
+esp_err_t esp_littlefs_wear_stats(const char* partition_label, esp_littlefs_wear_stats_t *stats)
+{
+    int index;
+    esp_err_t err;
+
+    assert(stats);
+    err = esp_littlefs_by_label(partition_label, &index);
+    if(err != ESP_OK) return err;
+    get_wear_stats(_efs[index], stats);
+
+    return ESP_OK;
+}
+
+esp_err_t esp_littlefs_partition_wear_stats(const esp_partition_t* partition, esp_littlefs_wear_stats_t *stats)
+{
+    int index;
+    esp_err_t err;
+
+    assert(stats);
+    err = esp_littlefs_by_partition(partition, &index);
+    if(err != ESP_OK) return err;
+    get_wear_stats(_efs[index], stats);
+
+    return ESP_OK;
+}
+
+#ifdef CONFIG_LITTLEFS_SDMMC_SUPPORT
+esp_err_t esp_littlefs_sdmmc_wear_stats(sdmmc_card_t *sdcard, esp_littlefs_wear_stats_t *stats)
+{
+    int index;
+    esp_err_t err;
+
+    assert(stats);
+    err = esp_littlefs_by_sdmmc_handle(sdcard, &index);
+    if(err != ESP_OK) return err;
+    get_wear_stats(_efs[index], stats);
+
+    return ESP_OK;
+}
+#endif
+
+#if ESP_LITTLEFS_HAS_BLOCKDEV
+esp_err_t esp_littlefs_blockdev_wear_stats(esp_blockdev_handle_t blockdev, esp_littlefs_wear_stats_t *stats)
+{
+    int index;
+    esp_err_t err;
+
+    assert(stats);
+    err = esp_littlefs_by_blockdev(blockdev, &index);
+    if(err != ESP_OK) return err;
+    get_wear_stats(_efs[index], stats);
+
+    return ESP_OK;
+}
+#endif
+#endif // CONFIG_LITTLEFS_WEAR_TRACKING
+
+#ifdef CONFIG_LITTLEFS_FLASH_SIM
+static void get_flash_sim_time(esp_littlefs_t *efs, uint64_t *time_us, bool reset) {
+    sem_take(efs);
+    if(time_us) *time_us = efs->flash_sim.time_us;
+    if(reset) efs->flash_sim.time_us = 0;
+    sem_give(efs);
+}
+
+esp_err_t esp_littlefs_flash_sim_time(const char* partition_label, uint64_t *time_us, bool reset){
+    int index;
+    esp_err_t err;
+
+    err = esp_littlefs_by_label(partition_label, &index);
+    if(err != ESP_OK) return err;
+    get_flash_sim_time(_efs[index], time_us, reset);
+
+    return ESP_OK;
+}
+
+esp_err_t esp_littlefs_partition_flash_sim_time(const esp_partition_t* partition, uint64_t *time_us, bool reset){
+    int index;
+    esp_err_t err;
+
+    err = esp_littlefs_by_partition(partition, &index);
+    if(err != ESP_OK) return err;
+    get_flash_sim_time(_efs[index], time_us, reset);
+
+    return ESP_OK;
+}
+#endif // CONFIG_LITTLEFS_FLASH_SIM
+
+#ifdef CONFIG_LITTLEFS_OVERLAY
+static esp_err_t checkpoint(esp_littlefs_t *efs) {
+    if(efs->overlay.journal == 0) {
+        ESP_LOGE(ESP_LITTLEFS_TAG, "Filesystem is not mounted with the write overlay.");
+        return ESP_ERR_INVALID_STATE;
+    }
+    return esp_littlefs_overlay_checkpoint(efs) == LFS_ERR_OK ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t esp_littlefs_checkpoint(const char* partition_label){
+    int index;
+    esp_err_t err;
+
+    err = esp_littlefs_by_label(partition_label, &index);
+    if(err != ESP_OK) return err;
+    return checkpoint(_efs[index]);
+}
+
+esp_err_t esp_littlefs_partition_checkpoint(const esp_partition_t* partition){
+    int index;
+    esp_err_t err;
+
+    err = esp_littlefs_by_partition(partition, &index);
+    if(err != ESP_OK) return err;
+    return checkpoint(_efs[index]);
+}
+#endif // CONFIG_LITTLEFS_OVERLAY
+
+static void get_arena_stats(esp_littlefs_t *efs, esp_littlefs_arena_stats_t *stats) {
+    sem_take(efs);
+    stats->size = efs->arena.size;
+    stats->file = efs->arena.pools[ESP_LITTLEFS_ARENA_FILE].stats;
+    stats->dir = efs->arena.pools[ESP_LITTLEFS_ARENA_DIR].stats;
+    stats->cache = efs->arena.pools[ESP_LITTLEFS_ARENA_CACHE].stats;
+    stats->lookahead = efs->arena.pools[ESP_LITTLEFS_ARENA_LOOKAHEAD].stats;
+    sem_give(efs);
+}
+
+esp_err_t esp_littlefs_arena_stats(const char* partition_label, esp_littlefs_arena_stats_t *stats){
+    int index;
+    esp_err_t err;
+
+    err = esp_littlefs_by_label(partition_label, &index);
+    if(err != ESP_OK) return err;
+    get_arena_stats(_efs[index], stats);
+
+    return ESP_OK;
+}
+
+esp_err_t esp_littlefs_partition_arena_stats(const esp_partition_t* partition, esp_littlefs_arena_stats_t *stats){
+    int index;
+    esp_err_t err;
+
+    err = esp_littlefs_by_partition(partition, &index);
+    if(err != ESP_OK) return err;
+    get_arena_stats(_efs[index], stats);
+
+    return ESP_OK;
+}
+
+#ifdef CONFIG_LITTLEFS_SDMMC_SUPPORT
+esp_err_t esp_littlefs_sdmmc_arena_stats(sdmmc_card_t *sdcard, esp_littlefs_arena_stats_t *stats)
+{
+    int index;
+    esp_err_t err;
+
+    err = esp_littlefs_by_sdmmc_handle(sdcard, &index);
+    if(err != ESP_OK) return err;
+    get_arena_stats(_efs[index], stats);
+
+    return ESP_OK;
+}
+#endif
+
+#if ESP_LITTLEFS_HAS_BLOCKDEV
+esp_err_t esp_littlefs_blockdev_arena_stats(esp_blockdev_handle_t blockdev, esp_littlefs_arena_stats_t *stats)
+{
+    int index;
+    esp_err_t err;
+
+    err = esp_littlefs_by_blockdev(blockdev, &index);
+    if (err != ESP_OK) return err;
+    get_arena_stats(_efs[index], stats);
+
+    return ESP_OK;
+}
+#endif
+
 #if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 4, 0)
 
 #ifdef CONFIG_VFS_SUPPORT_DIR
@@ -461,6 +900,12 @@ esp_err_t esp_vfs_littlefs_register(const esp_vfs_littlefs_conf_t * conf)
     const esp_vfs_t vfs = vfs_littlefs_create_struct(!conf->read_only);
 #endif // ESP_IDF_VERSION < ESP_IDF_VERSION_VAL(5, 4, 0)
 
+    /* The last FD table index marks the end of its free list */
+    if (conf->max_files >= ESP_LITTLEFS_FD_NONE) {
+        ESP_LOGE(ESP_LITTLEFS_TAG, "max_files must be less than %u", (unsigned int)ESP_LITTLEFS_FD_NONE);
+        return ESP_ERR_INVALID_ARG;
+    }
+
     esp_err_t err = esp_littlefs_init(conf, &index);
     if (err != ESP_OK) {
         ESP_LOGE(ESP_LITTLEFS_TAG, "Failed to initialize LittleFS");
@@ -568,6 +1013,28 @@ esp_err_t esp_vfs_littlefs_unregister_blockdev(esp_blockdev_handle_t blockdev)
 }
 #endif
 
+#ifdef CONFIG_LITTLEFS_RAM_SUPPORT
+esp_err_t esp_vfs_littlefs_unregister_ram(const char *base_path)
+{
+    assert(base_path);
+    int index;
+    if (esp_littlefs_by_ram(base_path, &index) != ESP_OK) {
+        ESP_LOGE(ESP_LITTLEFS_TAG, "RAM filesystem was never registered.");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    ESP_LOGV(ESP_LITTLEFS_TAG, "Unregistering RAM filesystem \"%s\"", base_path);
+    esp_err_t err = esp_vfs_unregister(_efs[index]->base_path);
+    if (err != ESP_OK) {
+        ESP_LOGE(ESP_LITTLEFS_TAG, "Failed to unregister RAM filesystem \"%s\"", base_path);
+        return err;
+    }
+    esp_littlefs_free(&_efs[index]);
+    _efs[index] = NULL;
+    return ESP_OK;
+}
+#endif
+
 esp_err_t esp_littlefs_format(const char* partition_label) {
     bool efs_free = false;
     int index = -1;
@@ -719,6 +1186,27 @@ exit:
 }
 #endif
 
+#ifdef CONFIG_LITTLEFS_RAM_SUPPORT
+esp_err_t esp_littlefs_format_ram(const char *base_path)
+{
+    assert(base_path);
+    int index;
+
+    ESP_LOGV(ESP_LITTLEFS_TAG, "Formatting RAM filesystem \"%s\"", base_path);
+
+    /* There is nothing to format unless it's registered; the contents only live as long as the mount */
+    if (esp_littlefs_by_ram(base_path, &index) != ESP_OK) {
+        ESP_LOGE(ESP_LITTLEFS_TAG, "RAM filesystem was never registered.");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    sem_take(_efs[index]);
+    esp_err_t err = format_from_efs(_efs[index]);
+    sem_give(_efs[index]);
+    return err;
+}
+#endif
+
 /********************
  * Static Functions *
  ********************/
@@ -822,14 +1310,50 @@ static void esp_littlefs_free(esp_littlefs_t ** efs)
     if (e == NULL) return;
     *efs = NULL;
 
+#ifdef CONFIG_LITTLEFS_PREERASE
+    esp_littlefs_preerase_stop(e);
+#endif
+#ifdef CONFIG_LITTLEFS_OVERLAY
+    esp_littlefs_overlay_stop(e);
+#endif
+
     if (e->fs) {
+#if CONFIG_LITTLEFS_ERASE_POLICY_DEFERRED
+        /* Issue any discards still queued by the backend */
+        if(e->cache_size > 0 && !e->read_only) e->cfg.sync(&e->cfg);
+#endif
         if(e->cache_size > 0) lfs_unmount(e->fs);
         free(e->fs);
     }
+#ifdef CONFIG_LITTLEFS_BLOCK_CACHE
+    esp_littlefs_block_cache_deinit(e);
+#endif
+#ifdef CONFIG_LITTLEFS_OVERLAY
+    /* Final checkpoint, after the block cache has written back into the overlay */
+    esp_littlefs_overlay_deinit(e);
+#endif
+#ifdef CONFIG_LITTLEFS_WEAR_TRACKING
+    esp_littlefs_wear_deinit(e);
+#endif
+#ifdef CONFIG_LITTLEFS_READAHEAD
+    free(e->readahead.buf);
+#endif
     if(e->lock) vSemaphoreDelete(e->lock);
 
 #ifdef CONFIG_LITTLEFS_MMAP_PARTITION
-    esp_partition_munmap(e->mmap_handle);
+    if (e->partition) littlefs_esp_part_munmap(e);
+#endif
+
+#ifdef CONFIG_LITTLEFS_SDMMC_SUPPORT
+    if (e->sdcard) {
+        /* DMA-capable caches are owned by us, not by littlefs */
+        free(e->cfg.read_buffer);
+        free(e->cfg.prog_buffer);
+    }
+#endif
+
+#ifdef CONFIG_LITTLEFS_RAM_SUPPORT
+    heap_caps_free(e->ram);
 #endif
 
 #if ESP_LITTLEFS_HAS_BLOCKDEV
@@ -841,17 +1365,17 @@ static void esp_littlefs_free(esp_littlefs_t ** efs)
 #endif
 
     esp_littlefs_free_fds(e);
+    esp_littlefs_arena_deinit(e);
     free(e);
 }
 
 #ifdef CONFIG_VFS_SUPPORT_DIR
 /**
  * @brief Free a vfs_littlefs_dir_t struct.
+ * @warning This must be called with lock taken
  */
-static void esp_littlefs_dir_free(vfs_littlefs_dir_t *dir){
-    if(dir == NULL) return;
-    if(dir->path) free(dir->path);
-    free(dir);
+static void esp_littlefs_dir_free(esp_littlefs_t *efs, vfs_littlefs_dir_t *dir){
+    esp_littlefs_arena_free(efs, dir);
 }
 #endif
 
@@ -977,6 +1501,35 @@ static esp_err_t esp_littlefs_by_blockdev(esp_blockdev_handle_t blockdev, int *
 }
 #endif
 
+#ifdef CONFIG_LITTLEFS_RAM_SUPPORT
+/**
+ * Get a mounted RAM-backed littlefs filesystem by mount point.
+ * @param[in] base_path
+ * @param[out] index index into _efs
+ * @return ESP_OK on success
+ */
+static esp_err_t esp_littlefs_by_ram(const char *base_path, int *index)
+{
+    if(!base_path || !index) return ESP_ERR_INVALID_ARG;
+
+    ESP_LOGV(ESP_LITTLEFS_TAG, "Searching for existing RAM filesystem at \"%s\"", base_path);
+
+    for (int i = 0; i < CONFIG_LITTLEFS_MAX_PARTITIONS; i++) {
+        esp_littlefs_t *p = _efs[i];
+        if (!p) continue;
+        if (!p->ram) continue;
+        if (strcmp(base_path, p->base_path) == 0) {
+            *index = i;
+            ESP_LOGV(ESP_LITTLEFS_TAG, "Found existing RAM filesystem \"%s\" at index %d", base_path, *index);
+            return ESP_OK;
+        }
+    }
+
+    ESP_LOGV(ESP_LITTLEFS_TAG, "Existing RAM filesystem \"%s\" not found", base_path);
+    return ESP_ERR_NOT_FOUND;
+}
+#endif
+
 /**
  * @brief Get the index of an unallocated LittleFS slot.
  * @param[out] index Indexd of free LittleFS slot
@@ -1041,8 +1594,49 @@ static void esp_littlefs_take_efs_lock(void) {
 
 
 #ifdef CONFIG_LITTLEFS_SDMMC_SUPPORT
-static esp_err_t esp_littlefs_init_sdcard(esp_littlefs_t** efs, sdmmc_card_t* sdcard, bool read_only)
+#define ESP_LITTLEFS_SDMMC_AUTO_BLOCK_MIN (16 * 1024)
+#define ESP_LITTLEFS_SDMMC_AUTO_BLOCK_MAX (64 * 1024)
+
+/**
+ * @brief Resolve the LittleFS block size to use for an SD card.
+ *
+ * @param requested esp_vfs_littlefs_conf_t::sdcard_block_size
+ * @return block size in bytes, or 0 if the requested size is invalid for this card.
+ */
+static size_t esp_littlefs_sdmmc_block_size(const sdmmc_card_t *sdcard, uint32_t requested)
+{
+    const size_t sector_size = sdcard->csd.sector_size;
+    size_t block_size = requested ? requested : CONFIG_LITTLEFS_SDMMC_BLOCK_SIZE;
+
+    if (block_size == 0 || block_size == ESP_LITTLEFS_SDMMC_BLOCK_SIZE_AUTO) {
+        /* Align blocks to the allocation unit the card manages internally; AUs are
+         * several MiB on SDHC/SDXC, so clamp to keep metadata pairs reasonably small. */
+        size_t au = 0;
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 1, 0)
+        if (!sdcard->is_mmc) {
+            au = (size_t)sdcard->ssr.alloc_unit_kb * 1024;
+        }
+#endif
+        block_size = au ? au : ESP_LITTLEFS_SDMMC_AUTO_BLOCK_MIN;
+        block_size = MIN(MAX(block_size, ESP_LITTLEFS_SDMMC_AUTO_BLOCK_MIN), ESP_LITTLEFS_SDMMC_AUTO_BLOCK_MAX);
+    }
+
+    if (block_size < sector_size || block_size % sector_size != 0) {
+        ESP_LOGE(ESP_LITTLEFS_TAG, "SD block size %u is not a multiple of the sector size %u",
+                 (unsigned)block_size, (unsigned)sector_size);
+        return 0;
+    }
+    return block_size;
+}
+
+static esp_err_t esp_littlefs_init_sdcard(esp_littlefs_t** efs, sdmmc_card_t* sdcard, uint32_t block_size, bool read_only)
 {
+    const size_t sector_size = sdcard->csd.sector_size;
+    block_size = esp_littlefs_sdmmc_block_size(sdcard, block_size);
+    if (block_size == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
     /* Allocate Context */
     *efs = esp_littlefs_calloc(1, sizeof(esp_littlefs_t));
     if (*efs == NULL) {
@@ -1062,11 +1656,18 @@ static esp_err_t esp_littlefs_init_sdcard(esp_littlefs_t** efs, sdmmc_card_t* sd
         (*efs)->cfg.sync  = littlefs_sdmmc_sync;
 
         // block device configuration
-        (*efs)->cfg.read_size = sdcard->csd.sector_size;
-        (*efs)->cfg.prog_size = sdcard->csd.sector_size;
-        (*efs)->cfg.block_size = sdcard->csd.sector_size;
-        (*efs)->cfg.block_count = sdcard->csd.capacity;
-        (*efs)->cfg.cache_size = MAX(CONFIG_LITTLEFS_CACHE_SIZE, sdcard->csd.sector_size); // Must not be smaller than SD sector size
+        (*efs)->cfg.read_size = sector_size;
+        (*efs)->cfg.prog_size = sector_size;
+        (*efs)->cfg.block_size = block_size;
+        (*efs)->cfg.block_count = sdcard->csd.capacity / (block_size / sector_size);
+
+        // Must not be smaller than SD sector size, and must evenly divide the block
+        size_t cache_size = MAX(CONFIG_LITTLEFS_CACHE_SIZE, sector_size);
+        cache_size -= cache_size % sector_size;
+        while (block_size % cache_size != 0) {
+            cache_size -= sector_size;
+        }
+        (*efs)->cfg.cache_size = cache_size;
         (*efs)->cfg.lookahead_size = CONFIG_LITTLEFS_LOOKAHEAD_SIZE;
         (*efs)->cfg.block_cycles = CONFIG_LITTLEFS_BLOCK_CYCLES;
 #if CONFIG_LITTLEFS_MULTIVERSION
@@ -1082,6 +1683,16 @@ static esp_err_t esp_littlefs_init_sdcard(esp_littlefs_t** efs, sdmmc_card_t* sd
 #endif
     }
 
+    /* The SDMMC driver splits transfers from non-DMA-capable buffers into single-sector
+     * bounce copies; keep the read/prog caches in DMA-capable memory so whole-cache
+     * transfers go out as one multi-block command. */
+    (*efs)->cfg.read_buffer = heap_caps_malloc((*efs)->cfg.cache_size, MALLOC_CAP_DMA);
+    (*efs)->cfg.prog_buffer = heap_caps_malloc((*efs)->cfg.cache_size, MALLOC_CAP_DMA);
+    if ((*efs)->cfg.read_buffer == NULL || (*efs)->cfg.prog_buffer == NULL) {
+        ESP_LOGE(ESP_LITTLEFS_TAG, "SD cache buffers could not be malloced");
+        return ESP_ERR_NO_MEM;
+    }
+
     (*efs)->lock = xSemaphoreCreateRecursiveMutex();
     if ((*efs)->lock == NULL) {
         ESP_LOGE(ESP_LITTLEFS_TAG, "mutex lock could not be created");
@@ -1098,6 +1709,83 @@ static esp_err_t esp_littlefs_init_sdcard(esp_littlefs_t** efs, sdmmc_card_t* sd
 }
 #endif // CONFIG_LITTLEFS_SDMMC_SUPPORT
 
+#ifdef CONFIG_LITTLEFS_RAM_SUPPORT
+static esp_err_t esp_littlefs_init_ram(esp_littlefs_t** efs, size_t size, bool read_only)
+{
+    const size_t block_count = size / CONFIG_LITTLEFS_BLOCK_SIZE;
+    if (block_count < 2) {
+        ESP_LOGE(ESP_LITTLEFS_TAG, "RAM filesystem needs at least 2 blocks of %u bytes", CONFIG_LITTLEFS_BLOCK_SIZE);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    /* Allocate Context */
+    *efs = esp_littlefs_calloc(1, sizeof(esp_littlefs_t));
+    if (*efs == NULL) {
+        ESP_LOGE(ESP_LITTLEFS_TAG, "esp_littlefs could not be malloced");
+        return ESP_ERR_NO_MEM;
+    }
+
+    /* Contents don't matter, the filesystem is always formatted before the first mount */
+    const size_t ram_size = block_count * CONFIG_LITTLEFS_BLOCK_SIZE;
+#if defined(CONFIG_LITTLEFS_RAM_HEAP_INTERNAL)
+    (*efs)->ram = heap_caps_malloc(ram_size, MALLOC_CAP_8BIT | MALLOC_CAP_INTERNAL);
+#elif defined(CONFIG_LITTLEFS_RAM_HEAP_SPIRAM)
+    (*efs)->ram = heap_caps_malloc(ram_size, MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM);
+#else
+    (*efs)->ram = heap_caps_malloc_prefer(ram_size, 2, MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM, MALLOC_CAP_8BIT | MALLOC_CAP_DEFAULT);
+#endif
+    if ((*efs)->ram == NULL) {
+        ESP_LOGE(ESP_LITTLEFS_TAG, "RAM filesystem of %u bytes could not be malloced", (unsigned)ram_size);
+        return ESP_ERR_NO_MEM;
+    }
+
+    { /* LittleFS Configuration */
+        (*efs)->cfg.context = *efs;
+        (*efs)->read_only = read_only;
+
+        // block device operations
+        (*efs)->cfg.read  = littlefs_ram_read;
+        (*efs)->cfg.prog  = littlefs_ram_write;
+        (*efs)->cfg.erase = littlefs_ram_erase;
+        (*efs)->cfg.sync  = littlefs_ram_sync;
+
+        // block device configuration
+        (*efs)->cfg.read_size = CONFIG_LITTLEFS_READ_SIZE;
+        (*efs)->cfg.prog_size = CONFIG_LITTLEFS_WRITE_SIZE;
+        (*efs)->cfg.block_size = CONFIG_LITTLEFS_BLOCK_SIZE;
+        (*efs)->cfg.block_count = block_count;
+        (*efs)->cfg.cache_size = CONFIG_LITTLEFS_CACHE_SIZE;
+        (*efs)->cfg.lookahead_size = CONFIG_LITTLEFS_LOOKAHEAD_SIZE;
+        (*efs)->cfg.block_cycles = -1;  // RAM doesn't wear out
+#if CONFIG_LITTLEFS_MULTIVERSION
+#if CONFIG_LITTLEFS_DISK_VERSION_MOST_RECENT
+        (*efs)->cfg.disk_version = 0;
+#elif CONFIG_LITTLEFS_DISK_VERSION_2_1
+        (*efs)->cfg.disk_version = 0x00020001;
+#elif CONFIG_LITTLEFS_DISK_VERSION_2_0
+        (*efs)->cfg.disk_version = 0x00020000;
+#else
+#error "CONFIG_LITTLEFS_MULTIVERSION enabled but no or unknown disk version selected!"
+#endif
+#endif
+    }
+
+    (*efs)->lock = xSemaphoreCreateRecursiveMutex();
+    if ((*efs)->lock == NULL) {
+        ESP_LOGE(ESP_LITTLEFS_TAG, "mutex lock could not be created");
+        return ESP_ERR_NO_MEM;
+    }
+
+    (*efs)->fs = esp_littlefs_calloc(1, sizeof(lfs_t));
+    if ((*efs)->fs == NULL) {
+        ESP_LOGE(ESP_LITTLEFS_TAG, "littlefs could not be malloced");
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
+#endif // CONFIG_LITTLEFS_RAM_SUPPORT
+
 #if ESP_LITTLEFS_HAS_BLOCKDEV
 static size_t gcd(size_t a, size_t b)
 {
@@ -1120,8 +1808,8 @@ static size_t lcm_size(size_t a, size_t b)
 /**
  * LittleFS requires cache_size % read_size == 0, cache_size % prog_size == 0, and block_size % cache_size == 0.
  *
- * Each open file uses vfs_littlefs_file_t::lfs_buffer[CONFIG_LITTLEFS_CACHE_SIZE] for lfs_file_config.buffer,
- * so cfg.cache_size must never exceed CONFIG_LITTLEFS_CACHE_SIZE (otherwise the VFS corrupts adjacent fields).
+ * Every open file gets a cache of cfg.cache_size too, so CONFIG_LITTLEFS_CACHE_SIZE caps the pick; mount with
+ * esp_vfs_littlefs_conf_t::cache_size to go beyond it.
  *
  * Callers must ensure block_sz % read_sz == 0 and block_sz % prog_sz == 0.
  */
@@ -1336,7 +2024,7 @@ static esp_err_t esp_littlefs_init_efs(esp_littlefs_t** efs, const esp_partition
     }
     (*efs)->partition = partition;
 
-#ifdef CONFIG_LITTLEFS_MMAP_PARTITION
+#if defined(CONFIG_LITTLEFS_MMAP_PARTITION) && !CONFIG_LITTLEFS_MMAP_WINDOWS
     esp_err_t err = esp_partition_mmap(partition, 0, partition->size, SPI_FLASH_MMAP_DATA, &(*efs)->mmap_data, &(*efs)->mmap_handle);
     if (err != ESP_OK) {
         ESP_LOGE(ESP_LITTLEFS_TAG, "esp_littlefs could not map data");
@@ -1394,6 +2082,39 @@ static esp_err_t esp_littlefs_init_efs(esp_littlefs_t** efs, const esp_partition
     return ESP_OK;
 }
 
+/**
+ * @brief Override the cache size picked for the medium
+ *
+ * Must run before anything sizes its buffers from cfg.cache_size.
+ */
+static esp_err_t esp_littlefs_set_cache_size(esp_littlefs_t *efs, uint32_t cache_size)
+{
+    lfs_size_t block_size = efs->cfg.block_size;
+
+    if (cache_size % efs->cfg.read_size != 0 || cache_size % efs->cfg.prog_size != 0
+            || block_size % cache_size != 0) {
+        ESP_LOGE(ESP_LITTLEFS_TAG, "cache_size %u must be a multiple of read=%u and prog=%u and a factor of block=%u",
+                 (unsigned)cache_size, (unsigned)efs->cfg.read_size, (unsigned)efs->cfg.prog_size, (unsigned)block_size);
+        return ESP_ERR_INVALID_ARG;
+    }
+    efs->cfg.cache_size = cache_size;
+
+#ifdef CONFIG_LITTLEFS_SDMMC_SUPPORT
+    if (efs->sdcard) {
+        /* The SD caches were already allocated for the default size */
+        free(efs->cfg.read_buffer);
+        free(efs->cfg.prog_buffer);
+        efs->cfg.read_buffer = heap_caps_malloc(cache_size, MALLOC_CAP_DMA);
+        efs->cfg.prog_buffer = heap_caps_malloc(cache_size, MALLOC_CAP_DMA);
+        if (efs->cfg.read_buffer == NULL || efs->cfg.prog_buffer == NULL) {
+            ESP_LOGE(ESP_LITTLEFS_TAG, "SD cache buffers could not be malloced");
+            return ESP_ERR_NO_MEM;
+        }
+    }
+#endif
+    return ESP_OK;
+}
+
 /**
  * @brief Initialize and mount littlefs
  * @param[in] conf Filesystem Configuration
@@ -1456,6 +2177,14 @@ static esp_err_t esp_littlefs_init(const esp_vfs_littlefs_conf_t* conf, int *ind
             err = ESP_ERR_INVALID_STATE;
             goto exit;
         }
+#endif
+#ifdef CONFIG_LITTLEFS_RAM_SUPPORT
+    } else if (conf->ram_size) {
+        if (conf->base_path && esp_littlefs_by_ram(conf->base_path, index) == ESP_OK) {
+            ESP_LOGE(ESP_LITTLEFS_TAG, "Mount point already used");
+            err = ESP_ERR_INVALID_STATE;
+            goto exit;
+        }
 #endif
     } else {
         // Find first partition with "littlefs" subtype.
@@ -1473,7 +2202,7 @@ static esp_err_t esp_littlefs_init(const esp_vfs_littlefs_conf_t* conf, int *ind
 
 #ifdef CONFIG_LITTLEFS_SDMMC_SUPPORT
 	if (conf->sdcard) {
-        err = esp_littlefs_init_sdcard(&efs, conf->sdcard, conf->read_only);
+        err = esp_littlefs_init_sdcard(&efs, conf->sdcard, conf->sdcard_block_size, conf->read_only);
         if(err != ESP_OK) {
             goto exit;
         }
@@ -1486,8 +2215,18 @@ static esp_err_t esp_littlefs_init(const esp_vfs_littlefs_conf_t* conf, int *ind
             goto exit;
         }
     } else
+#endif
+#ifdef CONFIG_LITTLEFS_RAM_SUPPORT
+    if (!partition && conf->ram_size) {
+        err = esp_littlefs_init_ram(&efs, conf->ram_size, conf->read_only);
+        if (err != ESP_OK) {
+            goto exit;
+        }
+    } else
 #endif
     {
+#if !CONFIG_IDF_TARGET_LINUX
+        /* The emulated flash of the linux target has no ROM flash chip descriptor */
         uint32_t flash_page_size = g_rom_flashchip.page_size;
         uint32_t log_page_size = CONFIG_LITTLEFS_PAGE_SIZE;
         if (log_page_size % flash_page_size != 0) {
@@ -1496,6 +2235,7 @@ static esp_err_t esp_littlefs_init(const esp_vfs_littlefs_conf_t* conf, int *ind
             err = ESP_ERR_INVALID_ARG;
             goto exit;
         }
+#endif
 
         err = esp_littlefs_init_efs(&efs, partition, conf->read_only);
 
@@ -1504,8 +2244,71 @@ static esp_err_t esp_littlefs_init(const esp_vfs_littlefs_conf_t* conf, int *ind
         }
     }
 
+    if (conf->cache_size) {
+        err = esp_littlefs_set_cache_size(efs, conf->cache_size);
+        if (err != ESP_OK) {
+            goto exit;
+        }
+    }
+
+#ifdef CONFIG_LITTLEFS_FLASH_SIM
+    if (efs->partition) esp_littlefs_flash_sim_init(efs);
+#endif
+
+#ifdef CONFIG_LITTLEFS_IO_STATS
+    esp_littlefs_io_stats_init(efs);
+#endif
+
+#ifdef CONFIG_LITTLEFS_OVERLAY
+    if (conf->overlay && !conf->read_only) {
+        if (efs->partition) {
+            if (conf->overlay_interval_ms > 3600000) {
+                ESP_LOGE(ESP_LITTLEFS_TAG, "overlay checkpoint interval is longer than an hour");
+                err = ESP_ERR_INVALID_ARG;
+                goto exit;
+            }
+            efs->overlay.interval_ms = conf->overlay_interval_ms ? conf->overlay_interval_ms
+                                                                 : CONFIG_LITTLEFS_OVERLAY_INTERVAL_MS;
+            err = esp_littlefs_overlay_init(efs);
+            if (err != ESP_OK) {
+                goto exit;
+            }
+        } else {
+            ESP_LOGW(ESP_LITTLEFS_TAG, "write overlay is only supported on flash partitions, ignoring");
+        }
+    }
+#endif
+
+#ifdef CONFIG_LITTLEFS_BLOCK_CACHE
+#ifdef CONFIG_LITTLEFS_RAM_SUPPORT
+    /* Nothing to gain from caching RAM in RAM */
+    if (!efs->ram)
+#endif
+    {
+        err = esp_littlefs_block_cache_init(efs);
+        if (err != ESP_OK) {
+            goto exit;
+        }
+    }
+#endif
+
+    efs->max_files = conf->max_files;
+    err = esp_littlefs_arena_init(efs, conf);
+    if (err != ESP_OK) {
+        goto exit;
+    }
+
     // Mount and Error Check
     _efs[*index] = efs;
+#ifdef CONFIG_LITTLEFS_RAM_SUPPORT
+    if (efs->ram) {
+        /* A fresh RAM filesystem never holds a valid one; format it even if it isn't mounted now */
+        err = format_from_efs(efs);
+        if (err != ESP_OK) {
+            goto exit;
+        }
+    }
+#endif
     if(!conf->dont_mount){
         int res;
 
@@ -1522,6 +2325,11 @@ static esp_err_t esp_littlefs_init(const esp_vfs_littlefs_conf_t* conf, int *ind
             if (conf->blockdev) {
                 err = esp_littlefs_format_blockdev(conf->blockdev);
             } else
+#endif
+#ifdef CONFIG_LITTLEFS_RAM_SUPPORT
+            if (efs->ram) {
+                err = format_from_efs(efs);
+            } else
 #endif
             {
                 err = esp_littlefs_format_partition(efs->partition);
@@ -1538,19 +2346,32 @@ static esp_err_t esp_littlefs_init(const esp_vfs_littlefs_conf_t* conf, int *ind
             err = ESP_FAIL;
             goto exit;
         }
-        efs->cache_size = 4;
-        efs->cache = esp_littlefs_calloc(efs->cache_size, sizeof(*efs->cache));
+        err = esp_littlefs_init_fds(efs);
+        if (err != ESP_OK) {
+            lfs_unmount(efs->fs);
+            goto exit;
+        }
 
         if(conf->grow_on_mount){
 #ifdef CONFIG_LITTLEFS_SDMMC_SUPPORT
             if (efs->sdcard) {
-                res = lfs_fs_grow(efs->fs, efs->sdcard->csd.capacity);
+                res = lfs_fs_grow(efs->fs, efs->cfg.block_count);
             } else
 #endif
 #if ESP_LITTLEFS_HAS_BLOCKDEV
             if (efs->bdl_handle) {
                 res = lfs_fs_grow(efs->fs, efs->cfg.block_count);
             } else
+#endif
+#ifdef CONFIG_LITTLEFS_RAM_SUPPORT
+            if (efs->ram) {
+                res = lfs_fs_grow(efs->fs, efs->cfg.block_count);
+            } else
+#endif
+#ifdef CONFIG_LITTLEFS_OVERLAY
+            if (efs->overlay.journal) {
+                res = lfs_fs_grow(efs->fs, efs->cfg.block_count);
+            } else
 #endif
             {
                 res = lfs_fs_grow(efs->fs, efs->partition->size / efs->cfg.block_size);
@@ -1561,6 +2382,50 @@ static esp_err_t esp_littlefs_init(const esp_vfs_littlefs_conf_t* conf, int *ind
                 goto exit;
             }
         }
+
+#ifdef CONFIG_LITTLEFS_WEAR_TRACKING
+        err = esp_littlefs_wear_init(efs);
+        if (err != ESP_OK) {
+            goto exit;
+        }
+#endif
+
+#ifdef CONFIG_LITTLEFS_PREERASE
+        if (conf->preerase && !conf->read_only) {
+            int (*erase)(const struct lfs_config *c, lfs_block_t block) = NULL;
+#if ESP_LITTLEFS_HAS_BLOCKDEV
+            if (efs->bdl_handle) {
+                /* Logical mode erases are governed by CONFIG_LITTLEFS_ERASE_POLICY instead */
+                if (!efs->bdl_logical_block_mode) erase = littlefs_bdl_erase;
+            } else
+#endif
+            if (efs->partition
+#ifdef CONFIG_LITTLEFS_OVERLAY
+                    /* Blocks free in RAM may still be in use by the last checkpoint on flash */
+                    && !efs->overlay.journal
+#endif
+            ) {
+                erase = littlefs_esp_part_erase;
+            }
+            if (erase == NULL) {
+                ESP_LOGW(ESP_LITTLEFS_TAG, "pre-erase is not supported on this media, ignoring");
+            } else {
+                err = esp_littlefs_preerase_start(efs, erase);
+                if (err != ESP_OK) {
+                    goto exit;
+                }
+            }
+        }
+#endif
+
+#ifdef CONFIG_LITTLEFS_OVERLAY
+        if (efs->overlay.journal) {
+            err = esp_littlefs_overlay_start(efs);
+            if (err != ESP_OK) {
+                goto exit;
+            }
+        }
+#endif
     }
 
     err = ESP_OK;
@@ -1608,19 +2473,62 @@ static inline int sem_give(esp_littlefs_t *efs) {
     return xSemaphoreGiveRecursive(efs->lock);
 }
 
+/**
+ * @brief lfs_file_read, taking the zero-copy path on mmapped partitions.
+ */
+static inline lfs_ssize_t esp_littlefs_file_read(esp_littlefs_t *efs, lfs_file_t *file, void *dst, size_t size) {
+#ifdef CONFIG_LITTLEFS_MMAP_ZERO_COPY_READ
+    if (efs->partition) {
+        return littlefs_esp_part_file_read_mmap(efs, file, dst, size);
+    }
+#endif
+    return lfs_file_read(efs->fs, file, dst, size);
+}
+
+/**
+ * @brief Move a file back to its own offset after pread/pwrite
+ *
+ * pread/pwrite don't seek back when they're done: a positional access right after
+ * another one then finds its data in the file's cache instead of flushing and
+ * refilling it twice. Every operation that uses the file offset calls this first.
+ * @warning This must be called with lock taken
+ */
+static int esp_littlefs_restore_cursor(esp_littlefs_t *efs, vfs_littlefs_file_t *file) {
+    if (!file->cursor_pending) {
+        return LFS_ERR_OK;
+    }
+    lfs_soff_t res = lfs_file_seek(efs->fs, &file->file, file->cursor, LFS_SEEK_SET);
+    if (res < 0) {
+        return res;
+    }
+    file->cursor_pending = false;
+    return LFS_ERR_OK;
+}
+
+/**
+ * @brief Position a file for pread/pwrite, remembering its own offset
+ * @warning This must be called with lock taken
+ */
+static int esp_littlefs_seek_positional(esp_littlefs_t *efs, vfs_littlefs_file_t *file, off_t offset) {
+    if (!file->cursor_pending) {
+        lfs_soff_t pos = lfs_file_tell(efs->fs, &file->file);
+        if (pos < 0) {
+            return pos;
+        }
+        file->cursor = pos;
+        file->cursor_pending = true;
+    }
+    lfs_soff_t res = lfs_file_seek(efs->fs, &file->file, offset, LFS_SEEK_SET);
+    return res < 0 ? res : LFS_ERR_OK;
+}
+
 
-/* We are using a double allocation system here, which an array and a linked list.
-   The array contains the pointer to the file descriptor (the index in the array is what's returned to the user).
-   The linked list is used for file descriptors.
-   This means that position of nodes in the list must stay consistent:
-   - Allocation is obvious (append to the list from the head, and realloc the pointers array)
-     There is still a O(N) search in the cache for a free position to store
-   - Searching is a O(1) process (good)
-   - Deallocation is more tricky. That is, for example,
-     if you need to remove node 5 in a 12 nodes list, you'll have to:
-       1) Mark the 5th position as freed (if it's the last position of the array realloc smaller)
-       2) Walk the list until finding the pointer to the node O(N) and scrub the node so the chained list stays consistent
-       3) Deallocate the node
+/* The file descriptor table is an array indexed by FD (the index is what's returned to the user).
+   Entries that aren't in use form a singly linked free list through the array itself, see esp_littlefs_fd_t:
+   - Allocation pops the head of the free list, O(1). When it's empty, the table is realloced
+     CONFIG_LITTLEFS_FD_CACHE_REALLOC_FACTOR times larger and the new entries are pushed onto it.
+   - Searching by FD is a O(1) array access
+   - Deallocation pushes the entry back onto the free list, O(1)
 */
 
 /**
@@ -1642,49 +2550,47 @@ static int esp_littlefs_allocate_fd(esp_littlefs_t *efs, vfs_littlefs_file_t **
     assert( efs->fd_count < UINT16_MAX );
     assert( efs->cache_size < UINT16_MAX );
 
-    /* Make sure there is enough space in the cache to store new fd */
-    if (efs->fd_count + 1 > efs->cache_size) {
-        uint16_t new_size = (uint16_t)MIN(UINT16_MAX, CONFIG_LITTLEFS_FD_CACHE_REALLOC_FACTOR * efs->cache_size);
-        /* Resize the cache */
-        vfs_littlefs_file_t ** new_cache = realloc(efs->cache, new_size * sizeof(*efs->cache));
-        if (!new_cache) {
+    /* Make sure there is a free entry in the table to store new fd */
+    if (efs->fd_free == ESP_LITTLEFS_FD_NONE && efs->max_files) {
+        /* A fixed table never grows */
+        errno = ENFILE;
+        return -1;
+    }
+    if (efs->fd_free == ESP_LITTLEFS_FD_NONE) {
+        uint16_t new_size = (uint16_t)MIN(UINT16_MAX - 1, CONFIG_LITTLEFS_FD_CACHE_REALLOC_FACTOR * efs->cache_size);
+        if (!esp_littlefs_grow_fds(efs, new_size)) {
             ESP_LOGE(ESP_LITTLEFS_TAG, "Unable to allocate file cache");
+            errno = ENOMEM;
             return -1; /* If it fails here, no harm is done to the filesystem, so it's safe */
         }
-        /* Zero out the new portions of the cache */
-        memset(&new_cache[efs->cache_size], 0, (new_size - efs->cache_size) * sizeof(*efs->cache));
-        efs->cache = new_cache;
-        efs->cache_size = new_size;
     }
 
 
-    /* Allocate file descriptor here now */
+    /* Allocate file descriptor here now, with room for the file's cache */
 #ifndef CONFIG_LITTLEFS_USE_ONLY_HASH
-    *file = esp_littlefs_calloc(1, sizeof(**file) + path_len);
+    *file = esp_littlefs_arena_calloc(efs, ESP_LITTLEFS_ARENA_FILE, sizeof(**file) + efs->cfg.cache_size + path_len);
 #else
-    *file = esp_littlefs_calloc(1, sizeof(**file));
+    *file = esp_littlefs_arena_calloc(efs, ESP_LITTLEFS_ARENA_FILE, sizeof(**file) + efs->cfg.cache_size);
 #endif
 
     if (*file == NULL) {
-        /* If it fails here, the file system might have a larger cache, but it's harmless, no need to reverse it */
+        /* If it fails here, the file system might have a larger table, but it's harmless, no need to reverse it */
         ESP_LOGE(ESP_LITTLEFS_TAG, "Unable to allocate FD");
         return -1;
     }
 
     /* Starting from here, nothing can fail anymore */
 
-#ifndef CONFIG_LITTLEFS_USE_ONLY_HASH
-    /* The trick here is to avoid dual allocation so the path pointer
-        should point to the next byte after it:
-        file => [ lfs_file | # | next | path | free_space ]
-                                            |  /\
-                                            |__/
+    /* The trick here is to avoid multiple allocations, so the cache and the path
+        are stored right after the struct, the cache sized for this mount:
+        file => [ vfs_littlefs_file_t | cache (cfg.cache_size) | path ]
     */
-    (*file)->path = (char*)(*file) + sizeof(**file);
+    (*file)->lfs_file_config.buffer = (uint8_t*)(*file) + sizeof(**file);
+#ifndef CONFIG_LITTLEFS_USE_ONLY_HASH
+    (*file)->path = (char*)(*file)->lfs_file_config.buffer + efs->cfg.cache_size;
 #endif
 
     /* initialize lfs_file_config */
-    (*file)->lfs_file_config.buffer = (*file)->lfs_buffer;
 #if ESP_LITTLEFS_ATTR_COUNT
     (*file)->lfs_file_config.attrs = (*file)->lfs_attr;
     (*file)->lfs_attr[0].type = ESP_LITTLEFS_ATTR_MTIME;
@@ -1693,16 +2599,10 @@ static int esp_littlefs_allocate_fd(esp_littlefs_t *efs, vfs_littlefs_file_t **
 #endif
     (*file)->lfs_file_config.attr_count = ESP_LITTLEFS_ATTR_COUNT;
 
-    /* Now find a free place in cache */
-    for(i=0; i < efs->cache_size; i++) {
-        if (efs->cache[i] == NULL) {
-            efs->cache[i] = *file;
-            break;
-        }
-    }
-    /* Save file in the list */
-    (*file)->next = efs->file;
-    efs->file = *file;
+    /* Take the head of the free list */
+    i = efs->fd_free;
+    efs->fd_free = (uint16_t)(efs->cache[i].free >> 1);
+    efs->cache[i].file = *file;
     efs->fd_count++;
     return i;
 }
@@ -1715,70 +2615,20 @@ static int esp_littlefs_allocate_fd(esp_littlefs_t *efs, vfs_littlefs_file_t **
  * @warning This must be called with lock taken
  */
 static int esp_littlefs_free_fd(esp_littlefs_t *efs, int fd){
-    vfs_littlefs_file_t * file, * head;
+    vfs_littlefs_file_t * file = esp_littlefs_get_file(efs, fd);
 
-    if((uint32_t)fd >= efs->cache_size) {
-        ESP_LOGE(ESP_LITTLEFS_TAG, "FD %d must be <%d.", fd, efs->cache_size);
+    if(file == NULL) {
+        ESP_LOGE(ESP_LITTLEFS_TAG, "FD %d is not open.", fd);
         return -1;
     }
 
-    /* Get the file descriptor to free it */
-    file = efs->cache[fd];
-    head = efs->file;
-    /* Search for file in SLL to remove it */
-    if (file == head) {
-        /* Last file, can't fail */
-        efs->file = efs->file->next;
-    } else {
-        while (head && head->next != file) {
-            head = head->next;
-        }
-        if (!head) {
-            ESP_LOGE(ESP_LITTLEFS_TAG, "Inconsistent list");
-            return -1;
-        }
-        /* Transaction starts here and can't fail anymore */
-        head->next = file->next;
-    }
-    efs->cache[fd] = NULL;
+    /* Push the entry onto the free list */
+    efs->cache[fd].free = ((uintptr_t)efs->fd_free << 1) | ESP_LITTLEFS_FD_FREE;
+    efs->fd_free = (uint16_t)fd;
     efs->fd_count--;
 
     ESP_LOGV(ESP_LITTLEFS_TAG, "Clearing FD");
-    free(file);
-
-#if 0
-    /* Realloc smaller if its possible
-     *     * Find and realloc based on number of trailing NULL ptrs in cache
-     *     * Leave some hysteris to prevent thrashing around resize points
-     * This is disabled for now because it adds unnecessary complexity
-     * and binary size increase that outweights its ebenfits.
-     */
-    if(efs->cache_size > CONFIG_LITTLEFS_FD_CACHE_MIN_SIZE) {
-        uint16_t n_free;
-        uint16_t new_size = efs->cache_size / CONFIG_LITTLEFS_FD_CACHE_REALLOC_FACTOR;
-
-        if(new_size >= CONFIG_LITTLEFS_FD_CACHE_MIN_SIZE) {
-            /* Count number of trailing NULL ptrs */
-            for(n_free=0; n_free < efs->cache_size; n_free++) {
-                if(efs->cache[efs->cache_size - n_free - 1] != NULL) {
-                    break;
-                }
-            }
-
-            if(n_free >= (efs->cache_size - new_size)){
-                new_size += CONFIG_LITTLEFS_FD_CACHE_HYST;
-                ESP_LOGV(ESP_LITTLEFS_TAG, "Reallocating cache %i -> %i", efs->cache_size, new_size);
-                vfs_littlefs_file_t ** new_cache;
-                new_cache = realloc(efs->cache, new_size * sizeof(*efs->cache));
-                /* No harm on realloc failure, continue using the oversized cache */
-                if(new_cache) {
-                    efs->cache = new_cache;
-                    efs->cache_size = new_size;
-                }
-            }
-        }
-    }
-#endif
+    esp_littlefs_arena_free(efs, file);
 
     return 0;
 }
@@ -1811,13 +2661,14 @@ static int esp_littlefs_get_fd_by_name(esp_littlefs_t *efs, const char *path){
     uint32_t hash = compute_hash(path);
 
     for(uint16_t i=0, j=0; i < efs->cache_size && j < efs->fd_count; i++){
-        if (efs->cache[i]) {
+        vfs_littlefs_file_t *file = esp_littlefs_get_file(efs, i);
+        if (file) {
             ++j;
 
             if (
-                efs->cache[i]->hash == hash  // Faster than strcmp
+                file->hash == hash  // Faster than strcmp
 #ifndef CONFIG_LITTLEFS_USE_ONLY_HASH
-                && strcmp(path, efs->cache[i]->path) == 0  // May as well check incase of hash collision. Usually short-circuited.
+                && strcmp(path, file->path) == 0  // May as well check incase of hash collision. Usually short-circuited.
 #endif
             ) {
                 ESP_LOGV(ESP_LITTLEFS_TAG, "Found \"%s\" at FD %d.", path, i);
@@ -1840,9 +2691,8 @@ static int vfs_littlefs_open(void* ctx, const char * path, int flags, int mode)
 #ifndef CONFIG_LITTLEFS_USE_ONLY_HASH
     size_t path_len = strlen(path) + 1;  // include NULL terminator
 #endif
-#if CONFIG_LITTLEFS_OPEN_DIR
     struct lfs_info info;
-#endif
+    bool frees_blocks = false;
 
     assert(path);
 
@@ -1857,6 +2707,11 @@ static int vfs_littlefs_open(void* ctx, const char * path, int flags, int mode)
     /* Get a FD */
     sem_take(efs);
 
+    /* Truncating a file that holds data is the only open that frees blocks */
+    if ((lfs_flags & LFS_O_TRUNC) && lfs_stat(efs->fs, path, &info) == LFS_ERR_OK) {
+        frees_blocks = info.type == LFS_TYPE_REG && info.size > 0;
+    }
+
 #if CONFIG_LITTLEFS_OPEN_DIR
     /* Check if it is a file with same path */
     if (flags & O_DIRECTORY) {
@@ -1879,7 +2734,7 @@ static int vfs_littlefs_open(void* ctx, const char * path, int flags, int mode)
     );
 
     if(fd < 0) {
-        errno = lfs_errno_remap(fd);
+        /* errno was set by esp_littlefs_allocate_fd */
         sem_give(efs);
         ESP_LOGV(ESP_LITTLEFS_TAG, "Error obtaining FD");
         return LFS_ERR_INVAL;
@@ -1928,15 +2783,16 @@ static int vfs_littlefs_open(void* ctx, const char * path, int flags, int mode)
         return LFS_ERR_INVAL;
     }
 
-    /* Sync after opening. If we are overwriting a file, this will free that
-     * file's blocks in storage, prevent OOS errors.
+    /* Sync after truncating a file with data. This frees that file's blocks in
+     * storage right away, preventing OOS errors while it is rewritten. Any other
+     * open has nothing to free, so it skips the metadata commit.
      * See TEST_CASE:
      *     "Rewriting file frees space immediately (#7426)"
      */
 #if CONFIG_LITTLEFS_OPEN_DIR
     if ( (flags & O_DIRECTORY) == 0 ) {
 #endif
-    if(!efs->read_only && lfs_flags != LFS_O_RDONLY)
+    if(frees_blocks)
     {
         res = esp_littlefs_file_sync(efs, file);
     }
@@ -1970,14 +2826,17 @@ static ssize_t vfs_littlefs_write(void* ctx, int fd, const void * data, size_t s
     vfs_littlefs_file_t *file = NULL;
 
     sem_take(efs);
-    if((uint32_t)fd > efs->cache_size) {
+    file = esp_littlefs_get_file(efs, fd);
+    if(file == NULL) {
         sem_give(efs);
-        ESP_LOGE(ESP_LITTLEFS_TAG, "FD %d must be <%d.", fd, efs->cache_size);
+        ESP_LOGE(ESP_LITTLEFS_TAG, "FD %d is not open.", fd);
         errno = EBADF;
         return -1;
     }
-    file = efs->cache[fd];
-    res = lfs_file_write(efs->fs, &file->file, data, size);
+    res = esp_littlefs_restore_cursor(efs, file);
+    if(res == 0) {
+        res = lfs_file_write(efs->fs, &file->file, data, size);
+    }
 #ifdef CONFIG_LITTLEFS_FLUSH_FILE_EVERY_WRITE
     if(res > 0) {
         vfs_littlefs_fsync(ctx, fd);
@@ -2006,14 +2865,17 @@ static ssize_t vfs_littlefs_read(void* ctx, int fd, void * dst, size_t size) {
     vfs_littlefs_file_t *file = NULL;
 
     sem_take(efs);
-    if((uint32_t)fd > efs->cache_size) {
+    file = esp_littlefs_get_file(efs, fd);
+    if(file == NULL) {
         sem_give(efs);
-        ESP_LOGE(ESP_LITTLEFS_TAG, "FD %d must be <%d.", fd, efs->cache_size);
+        ESP_LOGE(ESP_LITTLEFS_TAG, "FD %d is not open.", fd);
         errno = EBADF;
         return -1;
     }
-    file = efs->cache[fd];
-    res = lfs_file_read(efs->fs, &file->file, dst, size);
+    res = esp_littlefs_restore_cursor(efs, file);
+    if(res == 0) {
+        res = esp_littlefs_file_read(efs, &file->file, dst, size);
+    }
     sem_give(efs);
 
     if(res < 0){
@@ -2034,45 +2896,26 @@ static ssize_t vfs_littlefs_read(void* ctx, int fd, void * dst, size_t size) {
 static ssize_t vfs_littlefs_pwrite(void *ctx, int fd, const void *src, size_t size, off_t offset)
 {
     esp_littlefs_t *efs = (esp_littlefs_t *)ctx;
-    ssize_t res, save_res;
+    ssize_t res;
     vfs_littlefs_file_t *file = NULL;
 
     sem_take(efs);
-    if ((uint32_t)fd > efs->cache_size)
-    {
+    file = esp_littlefs_get_file(efs, fd);
+    if(file == NULL) {
         sem_give(efs);
-        ESP_LOGE(ESP_LITTLEFS_TAG, "FD %d must be <%d.", fd, efs->cache_size);
+        ESP_LOGE(ESP_LITTLEFS_TAG, "FD %d is not open.", fd);
         errno = EBADF;
         return -1;
     }
-    file = efs->cache[fd];
-
-    off_t old_offset = lfs_file_seek(efs->fs, &file->file, 0, SEEK_CUR);
-    if (old_offset < (off_t)0)
-    {
-        res = old_offset;
-        goto exit;
-    }
 
-    /* Set to wanted position.  */
-    res = lfs_file_seek(efs->fs, &file->file, offset, SEEK_SET);
-    if (res < (off_t)0)
-        goto exit;
-
-    /* Write out the data.  */
-    res = lfs_file_write(efs->fs, &file->file, src, size);
-
-    /* Now we have to restore the position.  If this fails we have to
-     return this as an error. But if the writing also failed we
-     return writing error.  */
-    save_res = lfs_file_seek(efs->fs, &file->file, old_offset, SEEK_SET);
-    if (res >= (ssize_t)0 && save_res < (off_t)0)
+    /* The file offset is restored lazily, by the next call that uses it */
+    res = esp_littlefs_seek_positional(efs, file, offset);
+    if (res == 0)
     {
-        res = save_res;
+        res = lfs_file_write(efs->fs, &file->file, src, size);
     }
     sem_give(efs);
 
-exit:
     if (res < 0)
     {
         errno = lfs_errno_remap(res);
@@ -2092,45 +2935,26 @@ exit:
 static ssize_t vfs_littlefs_pread(void *ctx, int fd, void *dst, size_t size, off_t offset)
 {
     esp_littlefs_t *efs = (esp_littlefs_t *)ctx;
-    ssize_t res, save_res;
+    ssize_t res;
     vfs_littlefs_file_t *file = NULL;
 
     sem_take(efs);
-    if ((uint32_t)fd > efs->cache_size)
-    {
+    file = esp_littlefs_get_file(efs, fd);
+    if(file == NULL) {
         sem_give(efs);
-        ESP_LOGE(ESP_LITTLEFS_TAG, "FD %d must be <%d.", fd, efs->cache_size);
+        ESP_LOGE(ESP_LITTLEFS_TAG, "FD %d is not open.", fd);
         errno = EBADF;
         return -1;
     }
-    file = efs->cache[fd];
-
-    off_t old_offset = lfs_file_seek(efs->fs, &file->file, 0, SEEK_CUR);
-    if (old_offset < (off_t)0)
-    {
-        res = old_offset;
-        goto exit;
-    }
-
-    /* Set to wanted position.  */
-    res = lfs_file_seek(efs->fs, &file->file, offset, SEEK_SET);
-    if (res < (off_t)0)
-        goto exit;
 
-    /* Read the data.  */
-    res = lfs_file_read(efs->fs, &file->file, dst, size);
-
-    /* Now we have to restore the position.  If this fails we have to
-     return this as an error. But if the reading also failed we
-     return reading error.  */
-    save_res = lfs_file_seek(efs->fs, &file->file, old_offset, SEEK_SET);
-    if (res >= (ssize_t)0 && save_res < (off_t)0)
+    /* The file offset is restored lazily, by the next call that uses it */
+    res = esp_littlefs_seek_positional(efs, file, offset);
+    if (res == 0)
     {
-        res = save_res;
+        res = esp_littlefs_file_read(efs, &file->file, dst, size);
     }
     sem_give(efs);
 
-exit:
     if (res < 0)
     {
         errno = lfs_errno_remap(res);
@@ -2153,15 +2977,14 @@ static int vfs_littlefs_close(void* ctx, int fd) {
     vfs_littlefs_file_t *file = NULL;
 
     sem_take(efs);
-    if((uint32_t)fd > efs->cache_size) {
+    file = esp_littlefs_get_file(efs, fd);
+    if(file == NULL) {
         sem_give(efs);
-        ESP_LOGE(ESP_LITTLEFS_TAG, "FD %d must be <%d.", fd, efs->cache_size);
+        ESP_LOGE(ESP_LITTLEFS_TAG, "FD %d is not open.", fd);
         errno = EBADF;
         return -1;
     }
 
-    file = efs->cache[fd];
-
 #if CONFIG_LITTLEFS_OPEN_DIR
     if ((file->file.flags & O_DIRECTORY) == 0) {
 #endif
@@ -2189,6 +3012,9 @@ static int vfs_littlefs_close(void* ctx, int fd) {
 #endif
 
     esp_littlefs_free_fd(efs, fd);
+#ifdef CONFIG_LITTLEFS_WEAR_TRACKING
+    esp_littlefs_wear_save(efs, false);
+#endif
     sem_give(efs);
     return res;
 }
@@ -2210,14 +3036,17 @@ static off_t vfs_littlefs_lseek(void* ctx, int fd, off_t offset, int mode) {
     }
 
     sem_take(efs);
-    if((uint32_t)fd > efs->cache_size) {
+    file = esp_littlefs_get_file(efs, fd);
+    if(file == NULL) {
         sem_give(efs);
-        ESP_LOGE(ESP_LITTLEFS_TAG, "FD %d must be <%d.", fd, efs->cache_size);
+        ESP_LOGE(ESP_LITTLEFS_TAG, "FD %d is not open.", fd);
         errno = EBADF;
         return -1;
     }
-    file = efs->cache[fd];
-    res = lfs_file_seek(efs->fs, &file->file, offset, whence);
+    res = esp_littlefs_restore_cursor(efs, file);
+    if(res == 0) {
+        res = lfs_file_seek(efs->fs, &file->file, offset, whence);
+    }
     sem_give(efs);
 
     if(res < 0){
@@ -2243,13 +3072,13 @@ static int vfs_littlefs_fsync(void* ctx, int fd)
 
 
     sem_take(efs);
-    if((uint32_t)fd > efs->cache_size) {
+    file = esp_littlefs_get_file(efs, fd);
+    if(file == NULL) {
         sem_give(efs);
-        ESP_LOGE(ESP_LITTLEFS_TAG, "FD %d must be <%d.", fd, efs->cache_size);
+        ESP_LOGE(ESP_LITTLEFS_TAG, "FD %d is not open.", fd);
         errno = EBADF;
         return -1;
     }
-    file = efs->cache[fd];
     res = esp_littlefs_file_sync(efs, file);
     sem_give(efs);
 
@@ -2278,13 +3107,13 @@ static int vfs_littlefs_fstat(void* ctx, int fd, struct stat * st) {
     st->st_blksize = efs->cfg.block_size;
 
     sem_take(efs);
-    if((uint32_t)fd > efs->cache_size) {
+    file = esp_littlefs_get_file(efs, fd);
+    if(file == NULL) {
         sem_give(efs);
-        ESP_LOGE(ESP_LITTLEFS_TAG, "FD must be <%d.", efs->cache_size);
+        ESP_LOGE(ESP_LITTLEFS_TAG, "FD %d is not open.", fd);
         errno = EBADF;
         return -1;
     }
-    file = efs->cache[fd];
     res = lfs_stat(efs->fs, file->path, &info);
     if (res < 0) {
         errno = lfs_errno_remap(res);
@@ -2451,23 +3280,21 @@ static DIR* vfs_littlefs_opendir(void* ctx, const char* name) {
     int res;
     vfs_littlefs_dir_t *dir = NULL;
 
-    dir = esp_littlefs_calloc(1, sizeof(vfs_littlefs_dir_t));
+    size_t path_len = strlen(name) + 1;  // include NULL terminator
+
+    sem_take(efs);
+    dir = esp_littlefs_arena_calloc(efs, ESP_LITTLEFS_ARENA_DIR, sizeof(vfs_littlefs_dir_t) + path_len);
     if( dir == NULL ) {
-        ESP_LOGE(ESP_LITTLEFS_TAG, "dir struct could not be malloced");
-        errno = ENOMEM;
+        /* errno was set by the allocator: ENOMEM, or ENFILE/ENAMETOOLONG for a max_dirs pool */
+        ESP_LOGE(ESP_LITTLEFS_TAG, "dir struct could not be allocated");
         goto exit;
     }
 
-    dir->path = strdup(name);
-    if(dir->path == NULL){
-        errno = ENOMEM;
-        ESP_LOGE(ESP_LITTLEFS_TAG, "dir path name could not be malloced");
-        goto exit;
-    }
+    /* As for files, the path is stored right after the struct */
+    dir->path = (char*)dir + sizeof(*dir);
+    memcpy(dir->path, name, path_len);
 
-    sem_take(efs);
     res = lfs_dir_open(efs->fs, &dir->d, dir->path);
-    sem_give(efs);
     if (res < 0) {
         errno = lfs_errno_remap(res);
 #ifndef CONFIG_LITTLEFS_USE_ONLY_HASH
@@ -2478,11 +3305,13 @@ static DIR* vfs_littlefs_opendir(void* ctx, const char* name) {
 #endif
         goto exit;
     }
+    sem_give(efs);
 
     return (DIR *)dir;
 
 exit:
-    esp_littlefs_dir_free(dir);
+    esp_littlefs_dir_free(efs, dir);
+    sem_give(efs);
     return NULL;
 }
 
@@ -2494,8 +3323,8 @@ static int vfs_littlefs_closedir(void* ctx, DIR* pdir) {
 
     sem_take(efs);
     res = lfs_dir_close(efs->fs, &dir->d);
-    sem_give(efs);
     if (res < 0) {
+        sem_give(efs);
         errno = lfs_errno_remap(res);
 #ifndef CONFIG_LITTLEFS_USE_ONLY_HASH
         ESP_LOGV(ESP_LITTLEFS_TAG, "Failed to closedir \"%s\". Error %s (%d)",
@@ -2506,7 +3335,8 @@ static int vfs_littlefs_closedir(void* ctx, DIR* pdir) {
         return res;
     }
 
-    esp_littlefs_dir_free(dir);
+    esp_littlefs_dir_free(efs, dir);
+    sem_give(efs);
     return 0;
 }
 
@@ -2667,14 +3497,13 @@ static ssize_t vfs_littlefs_truncate( void *ctx, const char *path, off_t size )
     int fd = vfs_littlefs_open( ctx, path, LFS_O_RDWR, 438 );
 
     sem_take(efs);
-    if((uint32_t)fd > efs->cache_size)
-    {
+    file = esp_littlefs_get_file(efs, fd);
+    if(file == NULL) {
         sem_give(efs);
-        ESP_LOGE(ESP_LITTLEFS_TAG, "FD %d must be <%d.", fd, efs->cache_size);
+        ESP_LOGE(ESP_LITTLEFS_TAG, "FD %d is not open.", fd);
         errno = EBADF;
         return -1;
     }
-    file = efs->cache[fd];
     res = lfs_file_truncate( efs->fs, &file->file, size );
     sem_give(efs);
 
@@ -2706,14 +3535,18 @@ static int vfs_littlefs_ftruncate(void *ctx, int fd, off_t size)
     vfs_littlefs_file_t *file = NULL;
 
     sem_take(efs);
-    if((uint32_t)fd > efs->cache_size) {
+    file = esp_littlefs_get_file(efs, fd);
+    if(file == NULL) {
         sem_give(efs);
-        ESP_LOGE(ESP_LITTLEFS_TAG, "FD %d must be <%d.", fd, efs->cache_size);
+        ESP_LOGE(ESP_LITTLEFS_TAG, "FD %d is not open.", fd);
         errno = EBADF;
         return -1;
     }
-    file = efs->cache[fd];
-    res = lfs_file_truncate( efs->fs, &file->file, size );
+    /* lfs_file_truncate() keeps the file's offset, make sure it's the right one */
+    res = esp_littlefs_restore_cursor(efs, file);
+    if(res == 0) {
+        res = lfs_file_truncate( efs->fs, &file->file, size );
+    }
     sem_give(efs);
 
     if(res < 0)
@@ -2753,6 +3586,9 @@ static int esp_littlefs_file_sync(esp_littlefs_t *efs, vfs_littlefs_file_t *file
     }
 #endif
     res = lfs_file_sync(efs->fs, &file->file);
+#ifdef CONFIG_LITTLEFS_WEAR_TRACKING
+    esp_littlefs_wear_save(efs, false);
+#endif
     return res;
 }
 
@@ -2906,21 +3742,14 @@ static int vfs_littlefs_fcntl(void* ctx, int fd, int cmd, int arg)
     const uint32_t flags_mask = LFS_O_WRONLY | LFS_O_RDONLY | LFS_O_RDWR;
 
     sem_take(efs);
-    if((uint32_t)fd > efs->cache_size) {
-        sem_give(efs);
-        ESP_LOGE(ESP_LITTLEFS_TAG, "FD %d must be <%d.", fd, efs->cache_size);
-        errno = EBADF;
-        return -1;
-    }
-
-    file = efs->cache[fd];
-    if (file) {
-        lfs_file = &efs->cache[fd]->file;
-    } else {
+    file = esp_littlefs_get_file(efs, fd);
+    if(file == NULL) {
         sem_give(efs);
+        ESP_LOGE(ESP_LITTLEFS_TAG, "FD %d is not open.", fd);
         errno = EBADF;
         return -1;
     }
+    lfs_file = &file->file;
 
     if (cmd == F_GETFL) {
         if ((lfs_file->flags & flags_mask) == LFS_O_WRONLY) {
@@ -8,6 +8,65 @@
 
 const char ESP_LITTLEFS_TAG[] = "esp_littlefs";
 
+#if CONFIG_LITTLEFS_CRC_ROM
+#include "esp_rom_crc.h"
+
+// The ROM routine inverts the CRC on the way in and out; littlefs doesn't
+uint32_t lfs_crc(uint32_t crc, const void *buffer, size_t size) {
+    return ~esp_rom_crc32_le(~crc, buffer, size);
+}
+
+#elif CONFIG_LITTLEFS_CRC_SLICING8
+
+static uint32_t crc_table[8][256];
+static int crc_table_ready;
+
+static void crc_table_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = (c >> 1) ^ ((c & 1) ? 0xedb88320 : 0);
+        }
+        crc_table[0][i] = c;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        for (int t = 1; t < 8; t++) {
+            crc_table[t][i] = (crc_table[t - 1][i] >> 8) ^ crc_table[0][crc_table[t - 1][i] & 0xff];
+        }
+    }
+    // Concurrent first calls build identical tables; publish only once complete
+    __atomic_store_n(&crc_table_ready, 1, __ATOMIC_RELEASE);
+}
+
+// Software CRC implementation processing 8 bytes per step (little-endian targets)
+uint32_t lfs_crc(uint32_t crc, const void *buffer, size_t size) {
+    const uint8_t *data = buffer;
+
+    if (!__atomic_load_n(&crc_table_ready, __ATOMIC_ACQUIRE)) {
+        crc_table_init();
+    }
+
+    for (; size > 0 && ((uintptr_t)data & 3); size--) {
+        crc = (crc >> 8) ^ crc_table[0][(crc ^ *data++) & 0xff];
+    }
+    for (; size >= 8; size -= 8, data += 8) {
+        uint32_t lo, hi;
+        memcpy(&lo, data, 4);
+        memcpy(&hi, data + 4, 4);
+        lo ^= crc;
+        crc = crc_table[7][lo & 0xff] ^ crc_table[6][(lo >> 8) & 0xff] ^
+              crc_table[5][(lo >> 16) & 0xff] ^ crc_table[4][lo >> 24] ^
+              crc_table[3][hi & 0xff] ^ crc_table[2][(hi >> 8) & 0xff] ^
+              crc_table[1][(hi >> 16) & 0xff] ^ crc_table[0][hi >> 24];
+    }
+    for (; size > 0; size--) {
+        crc = (crc >> 8) ^ crc_table[0][(crc ^ *data++) & 0xff];
+    }
+
+    return crc;
+}
+
+#else
 // Software CRC implementation with small lookup table
 uint32_t lfs_crc(uint32_t crc, const void *buffer, size_t size) {
     static const uint32_t rtable[16] = {
@@ -26,3 +85,4 @@ uint32_t lfs_crc(uint32_t crc, const void *buffer, size_t size) {
 
     return crc;
 }
+#endif
@@ -3,11 +3,13 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <stdlib.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
 #include "esp_vfs.h"
 #include "esp_partition.h"
+#include "esp_heap_caps.h"
 #include "esp_littlefs.h"
 #include "littlefs/lfs.h"
 #include "sdkconfig.h"
@@ -20,6 +22,19 @@
 extern "C" {
 #endif
 
+static inline void * esp_littlefs_calloc(size_t __nmemb, size_t __size) {
+    /* Used internally by this wrapper only */
+#if defined(CONFIG_LITTLEFS_MALLOC_STRATEGY_INTERNAL)
+    return heap_caps_calloc(__nmemb, __size, MALLOC_CAP_8BIT | MALLOC_CAP_INTERNAL);
+#elif defined(CONFIG_LITTLEFS_MALLOC_STRATEGY_SPIRAM)
+    return heap_caps_calloc(__nmemb, __size, MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM);
+#elif defined(CONFIG_LITTLEFS_MALLOC_STRATEGY_SPIRAM_PREFER)
+    return heap_caps_calloc_prefer(__nmemb, __size, 2, MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM, MALLOC_CAP_8BIT | MALLOC_CAP_DEFAULT);
+#else /* CONFIG_LITTLEFS_MALLOC_STRATEGY_DISABLE, CONFIG_LITTLEFS_MALLOC_STRATEGY_DEFAULT or not defined */
+    return calloc(__nmemb, __size);
+#endif
+}
+
 #if CONFIG_LITTLEFS_USE_MTIME
     #define ESP_LITTLEFS_ATTR_COUNT 1
 #else
@@ -28,7 +43,6 @@ extern "C" {
 
 /**
  * @brief a file descriptor
- * That's also a singly linked list used for keeping tracks of all opened file descriptor 
  *
  * Shortcomings/potential issues of 32-bit hash (when CONFIG_LITTLEFS_USE_ONLY_HASH) listed here:
  *     * unlink - If a different file is open that generates a hash collision, it will report an
@@ -45,21 +59,273 @@ extern "C" {
 typedef struct _vfs_littlefs_file_t {
     lfs_file_t file;
 
-    /* Allocate all other necessary buffers */
+    /* Allocate all other necessary buffers; the file's cache of cfg.cache_size
+       bytes follows the struct in the same allocation */
     struct lfs_file_config lfs_file_config;
-    uint8_t lfs_buffer[CONFIG_LITTLEFS_CACHE_SIZE];
 #if ESP_LITTLEFS_ATTR_COUNT
     struct lfs_attr lfs_attr[ESP_LITTLEFS_ATTR_COUNT];
     time_t lfs_attr_time_buffer;
 #endif
 
+    /* pread/pwrite leave the littlefs file where they stopped, so the next positional
+       access can hit its cache; the file offset is restored from here lazily */
+    lfs_off_t cursor;
+    bool cursor_pending;
+
     uint32_t hash;
-    struct _vfs_littlefs_file_t * next;       /*!< Pointer to next file in Singly Linked List */
 #ifndef CONFIG_LITTLEFS_USE_ONLY_HASH
     char     * path;
 #endif
 } vfs_littlefs_file_t;
 
+#define ESP_LITTLEFS_FD_FREE 1                /*!< Tag of free file descriptor table entries */
+#define ESP_LITTLEFS_FD_NONE UINT16_MAX       /*!< End of the free list of the file descriptor table */
+
+/**
+ * @brief An entry of the file descriptor table
+ *
+ * Free entries form a singly linked list through the table: they hold the index of
+ * the next free entry shifted left by one, tagged with ESP_LITTLEFS_FD_FREE. File
+ * structs are at least 4-byte aligned, so the tag bit tells the two apart.
+ */
+typedef union {
+    vfs_littlefs_file_t *file;                /*!< Open file */
+    uintptr_t            free;                /*!< Next free entry, tagged with ESP_LITTLEFS_FD_FREE */
+} esp_littlefs_fd_t;
+
+/**
+ * @brief littlefs DIR structure
+ */
+typedef struct {
+    DIR dir;            /*!< VFS DIR struct */
+    lfs_dir_t d;        /*!< littlefs DIR struct */
+    struct dirent e;    /*!< Last open dirent */
+    long offset;        /*!< Offset of the current dirent */
+    char *path;         /*!< Requested directory name */
+} vfs_littlefs_dir_t;
+
+/**
+ * @brief Size classes of the per-mount arena
+ */
+typedef enum {
+    ESP_LITTLEFS_ARENA_FILE,                  /*!< vfs_littlefs_file_t plus its path */
+    ESP_LITTLEFS_ARENA_DIR,                   /*!< vfs_littlefs_dir_t plus its path */
+    ESP_LITTLEFS_ARENA_CACHE,                 /*!< littlefs read and prog caches */
+    ESP_LITTLEFS_ARENA_LOOKAHEAD,             /*!< littlefs lookahead buffer */
+    ESP_LITTLEFS_ARENA_CLASSES,
+} esp_littlefs_arena_class_t;
+
+/**
+ * @brief Fixed-size slots of one size class
+ */
+typedef struct {
+    uint8_t *base;                            /*!< First slot */
+    void    *free;                            /*!< Free list threaded through the first word of free slots */
+    bool     fixed;                           /*!< Never fall back to the heap (max_files/max_dirs) */
+    esp_littlefs_arena_class_stats_t stats;
+} esp_littlefs_arena_pool_t;
+
+/**
+ * @brief Per-mount arena, one allocation carved into a pool per size class
+ */
+typedef struct {
+    uint8_t *mem;                             /*!< The arena; NULL if the mount doesn't use one */
+    size_t   size;                            /*!< Size of mem in bytes */
+    esp_littlefs_arena_pool_t pools[ESP_LITTLEFS_ARENA_CLASSES];
+} esp_littlefs_arena_t;
+
+#if CONFIG_LITTLEFS_ERASE_POLICY_DEFERRED
+/**
+ * @brief A contiguous range of erased-but-not-yet-discarded blocks
+ */
+typedef struct {
+    lfs_block_t start;                        /*!< First block of the range */
+    lfs_size_t  count;                        /*!< Number of blocks in the range */
+} esp_littlefs_erase_range_t;
+
+/**
+ * @brief Backend callback used to issue a queued discard/erase for a range of blocks.
+ *
+ * @return errorcode. 0 on success.
+ */
+typedef int (*esp_littlefs_discard_t)(const struct lfs_config *c, lfs_block_t start, lfs_size_t count);
+#endif
+
+#ifdef CONFIG_LITTLEFS_BLOCK_CACHE
+/**
+ * @brief A single block-sized slot of the block cache
+ */
+typedef struct {
+    uint8_t     *data;                        /*!< block_size bytes mirroring the block's contents */
+    lfs_block_t  block;                       /*!< Block held by this slot */
+    lfs_off_t    dirty_start;                 /*!< Start of the not yet written back range */
+    lfs_off_t    dirty_end;                   /*!< End of the not yet written back range; empty if equal to dirty_start */
+    uint32_t     dirty_seq;                   /*!< Sequence number of when the slot was first dirtied */
+    bool         valid;                       /*!< Slot holds a block */
+    bool         referenced;                  /*!< CLOCK reference bit */
+    bool         erase_pending;               /*!< Block must be erased before the dirty range is written back */
+} esp_littlefs_cache_slot_t;
+
+/**
+ * @brief Write-back block cache stacked on top of a backend's lfs_config callbacks
+ */
+typedef struct {
+    esp_littlefs_cache_slot_t slots[CONFIG_LITTLEFS_BLOCK_CACHE_SLOTS];
+    esp_littlefs_cache_slot_t *last_dirty;    /*!< Most recently dirtied slot */
+    size_t   hand;                            /*!< CLOCK hand */
+    uint32_t seq;                             /*!< Dirty sequence counter */
+
+    int (*backend_read)(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, void *buffer, lfs_size_t size);
+    int (*backend_prog)(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, const void *buffer, lfs_size_t size);
+    int (*backend_erase)(const struct lfs_config *c, lfs_block_t block);
+    int (*backend_sync)(const struct lfs_config *c);
+
+    uint32_t hits;                            /*!< Reads served from the cache */
+    uint32_t misses;                          /*!< Reads that went to the backend */
+    uint32_t writebacks;                      /*!< Dirty ranges written back to the backend */
+} esp_littlefs_block_cache_t;
+#endif
+
+#ifdef CONFIG_LITTLEFS_OVERLAY
+#define ESP_LITTLEFS_OVERLAY_JOURNAL_BLOCKS (CONFIG_LITTLEFS_OVERLAY_BLOCKS + 1) /*!< Blocks reserved for the checkpoint journal */
+
+/**
+ * @brief A block held by the RAM write overlay
+ */
+typedef struct {
+    uint8_t     *data;                        /*!< block_size bytes with the block's latest contents */
+    lfs_block_t  block;                       /*!< Block held by this slot */
+    lfs_off_t    dirty_start;                 /*!< Start of the range programmed since the last checkpoint */
+    lfs_off_t    dirty_end;                   /*!< End of that range; empty if equal to dirty_start */
+    bool         valid;                       /*!< Slot holds a block */
+    bool         erased;                      /*!< Block was erased since the last checkpoint */
+} esp_littlefs_overlay_slot_t;
+
+/**
+ * @brief RAM write overlay stacked on top of a partition's lfs_config callbacks
+ */
+typedef struct {
+    esp_littlefs_overlay_slot_t slots[CONFIG_LITTLEFS_OVERLAY_BLOCKS];
+    size_t       used;                        /*!< Number of valid slots */
+    lfs_block_t  journal;                     /*!< First journal block, right after the filesystem; 0 if not in use */
+    lfs_size_t   journal_next;                /*!< Journal block (relative to `journal`) the next checkpoint starts at */
+    uint32_t     seq;                         /*!< Sequence number of the next checkpoint */
+    uint32_t     checkpoints;                 /*!< Checkpoints taken since mounting */
+    uint32_t     interval_ms;                 /*!< Time between periodic checkpoints */
+    uint8_t     *buf;                         /*!< block_size staging buffer for the journal */
+
+    TaskHandle_t      task;                   /*!< Periodic checkpoint task; NULL if not running */
+    SemaphoreHandle_t done;                   /*!< Given by the task right before it exits */
+    volatile bool     stop;                   /*!< Ask the task to exit */
+
+    int (*backend_read)(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, void *buffer, lfs_size_t size);
+    int (*backend_prog)(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, const void *buffer, lfs_size_t size);
+    int (*backend_erase)(const struct lfs_config *c, lfs_block_t block);
+    int (*backend_sync)(const struct lfs_config *c);
+} esp_littlefs_overlay_t;
+#endif
+
+#ifdef CONFIG_LITTLEFS_FLASH_SIM
+/**
+ * @brief Flash timing model stacked on top of a backend's lfs_config callbacks
+ */
+typedef struct {
+    uint64_t time_us;                         /*!< Modelled device time */
+    uint32_t time_ns;                         /*!< Sub-microsecond remainder of time_us */
+
+    int (*backend_read)(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, void *buffer, lfs_size_t size);
+    int (*backend_prog)(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, const void *buffer, lfs_size_t size);
+} esp_littlefs_flash_sim_t;
+#endif
+
+#ifdef CONFIG_LITTLEFS_WEAR_TRACKING
+/**
+ * @brief Per-block erase counters
+ */
+typedef struct {
+    uint32_t   *counts;                       /*!< Erase count of each block; NULL if not tracked */
+    lfs_size_t  block_count;                  /*!< Number of entries in counts */
+    uint32_t    unsaved;                      /*!< Erases counted since the last save */
+    bool       *dirty;                        /*!< Per NVS chunk: counters changed since the last save */
+    bool        label_saved;                  /*!< The label is stored in NVS under `key` */
+    char        key[16];                      /*!< Hash of the label the counters are saved under in NVS;
+                                                   empty if not persisted */
+} esp_littlefs_wear_t;
+#endif
+
+#ifdef CONFIG_LITTLEFS_IO_STATS
+/**
+ * @brief I/O counters stacked on top of a backend's lfs_config callbacks
+ */
+typedef struct {
+    esp_littlefs_io_stats_t stats;
+
+    int (*backend_read)(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, void *buffer, lfs_size_t size);
+    int (*backend_prog)(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, const void *buffer, lfs_size_t size);
+    int (*backend_erase)(const struct lfs_config *c, lfs_block_t block);
+    int (*backend_sync)(const struct lfs_config *c);
+} esp_littlefs_io_stats_layer_t;
+#endif
+
+#ifdef CONFIG_LITTLEFS_READAHEAD
+/**
+ * @brief Sequential read-ahead window
+ */
+typedef struct {
+    uint8_t *buf;                             /*!< CONFIG_LITTLEFS_READAHEAD_SIZE bytes, allocated on first use */
+    uint64_t start;                           /*!< Device address of buf[0] */
+    size_t   len;                             /*!< Valid bytes in buf; 0 if the window is empty */
+    uint64_t next;                            /*!< Device address a sequential read would start at */
+    uint8_t  streak;                          /*!< Number of consecutive sequential reads */
+} esp_littlefs_readahead_t;
+
+/**
+ * @brief Backend read at an absolute device address, used to fill the read-ahead window.
+ *
+ * @return errorcode. 0 on success.
+ */
+typedef int (*esp_littlefs_raw_read_t)(const struct lfs_config *c, uint64_t addr, void *buffer, size_t size);
+#endif
+
+#ifdef CONFIG_LITTLEFS_PREERASE
+/**
+ * @brief State of the background pre-erase pool
+ */
+typedef struct {
+    TaskHandle_t      task;                   /*!< Pre-erase task; NULL if not running */
+    SemaphoreHandle_t done;                   /*!< Given by the task right before it exits */
+    volatile bool     stop;                   /*!< Ask the task to exit */
+    bool              changed;                /*!< A prog/erase went through the HAL since `used` was computed */
+    bool              traversed;              /*!< `used` has been computed at least once */
+    uint32_t         *erased;                 /*!< Bitmap of blocks erased ahead of time and not programmed since */
+    uint32_t         *used;                   /*!< Bitmap of blocks in use when last traversed, plus those
+                                                   programmed or erased by littlefs since */
+    lfs_size_t        block_count;            /*!< Number of blocks covered by the bitmaps */
+    lfs_size_t        pool;                   /*!< Number of bits set in `erased` */
+    lfs_block_t       hint;                   /*!< Block after the one littlefs erased most recently */
+    int (*erase)(const struct lfs_config *c, lfs_block_t block); /*!< HAL erase used by the task */
+} esp_littlefs_preerase_t;
+#endif
+
+#if CONFIG_LITTLEFS_MMAP_WINDOWS
+#ifdef CONFIG_MMU_PAGE_SIZE
+#define ESP_LITTLEFS_MMAP_WINDOW_SIZE CONFIG_MMU_PAGE_SIZE /*!< One MMU page */
+#else
+#define ESP_LITTLEFS_MMAP_WINDOW_SIZE 0x10000 /*!< One MMU page; older IDF only supports 64K pages */
+#endif
+
+/**
+ * @brief A window of a partition mapped into the data address space
+ */
+typedef struct {
+    const uint8_t *data;                      /*!< Start of the mapped window; NULL if unused */
+    esp_partition_mmap_handle_t handle;       /*!< Handle to unmap the window */
+    size_t         offset;                    /*!< Partition offset of the window; 0 for a window
+                                                   whose MMU page starts before the partition */
+    uint32_t       last_used;                 /*!< Value of mmap_tick at the last access */
+} esp_littlefs_mmap_window_t;
+#endif
+
 /**
  * @brief littlefs definition structure
  */
@@ -80,25 +346,90 @@ typedef struct {
      *  (not geometry \c erase_size). Physical erase alignment is not enforced in this path. */
     bool                   bdl_logical_block_mode;
 #endif
+#ifdef CONFIG_LITTLEFS_RAM_SUPPORT
+    uint8_t *ram;                             /*!< Block array of a RAM-backed filesystem */
+#endif
 
 #ifdef CONFIG_LITTLEFS_MMAP_PARTITION
+#if CONFIG_LITTLEFS_MMAP_WINDOWS
+    esp_littlefs_mmap_window_t mmap_windows[CONFIG_LITTLEFS_MMAP_WINDOWS]; /*!< Windows of the partition mapped on demand */
+    uint32_t mmap_tick;                       /*!< LRU clock for mmap_windows */
+#else
     const void *mmap_data;                    /*!< Buffer of mmapped partition */
     esp_partition_mmap_handle_t mmap_handle;  /*!< Handle to mmapped partition */
 #endif
+#endif
+
+#if CONFIG_LITTLEFS_ERASE_POLICY_DEFERRED
+    esp_littlefs_erase_range_t erase_queue[CONFIG_LITTLEFS_ERASE_QUEUE_LEN]; /*!< Pending discards, sorted by start block */
+    uint8_t erase_queue_len;                  /*!< Number of used entries in erase_queue */
+#endif
+
+#ifdef CONFIG_LITTLEFS_FLASH_SIM
+    esp_littlefs_flash_sim_t flash_sim;       /*!< Flash timing model */
+#endif
+
+#ifdef CONFIG_LITTLEFS_WEAR_TRACKING
+    esp_littlefs_wear_t wear;                 /*!< Per-block erase counters */
+#endif
+
+#ifdef CONFIG_LITTLEFS_IO_STATS
+    esp_littlefs_io_stats_layer_t io_stats;   /*!< Block device I/O counters */
+#endif
+
+#ifdef CONFIG_LITTLEFS_OVERLAY
+    esp_littlefs_overlay_t overlay;           /*!< RAM write overlay of a partition */
+#endif
+
+#ifdef CONFIG_LITTLEFS_BLOCK_CACHE
+    esp_littlefs_block_cache_t bcache;        /*!< Block cache in front of the backend callbacks */
+#endif
+
+#ifdef CONFIG_LITTLEFS_READAHEAD
+    esp_littlefs_readahead_t readahead;       /*!< Read-ahead window of the partition/BDL read callbacks */
+#endif
+
+#ifdef CONFIG_LITTLEFS_ERASE_BLANK_CHECK
+    uint32_t erase_skipped;                   /*!< Partition erases skipped because the block was already blank */
+#endif
+
+#ifdef CONFIG_LITTLEFS_PREERASE
+    esp_littlefs_preerase_t preerase;         /*!< Background pre-erase pool */
+#endif
+
+    esp_littlefs_arena_t arena;               /*!< Fixed-size pools for this mount's objects and buffers */
 
     char base_path[ESP_VFS_PATH_MAX+1];       /*!< Mount point */
 
     struct lfs_config cfg;                    /*!< littlefs Mount configuration */
 
-    vfs_littlefs_file_t *file;                /*!< Singly Linked List of files */
-
-    vfs_littlefs_file_t **cache;              /*!< A cache of pointers to the opened files */
-    uint16_t             cache_size;          /*!< The cache allocated size (in pointers) */
+    esp_littlefs_fd_t   *cache;               /*!< File descriptor table, indexed by FD */
+    uint16_t             cache_size;          /*!< Number of entries in the table; 0 if not mounted */
     uint16_t             fd_count;            /*!< The count of opened file descriptor used to speed up computation */
+    uint16_t             fd_free;             /*!< First free entry of the table; ESP_LITTLEFS_FD_NONE if all are in use */
+    uint16_t             max_files;           /*!< Fixed size of the table; 0 if it grows on demand */
     bool                 read_only;           /*!< Filesystem is read-only */
 } esp_littlefs_t;
 
 #ifdef CONFIG_LITTLEFS_MMAP_PARTITION
+/**
+ * @brief Get a pointer to partition data through the memory mapping.
+ *
+ * With CONFIG_LITTLEFS_MMAP_WINDOWS, the window holding part_off is mapped on
+ * demand (replacing the least recently used one) and *len is clamped to the
+ * end of that window.
+ *
+ * @param[inout] len Number of bytes wanted; set to the number of bytes available at the returned pointer.
+ *
+ * @return Pointer to the data, or NULL if it couldn't be mapped.
+ */
+const uint8_t *littlefs_esp_part_mmap(esp_littlefs_t * efs, size_t part_off, size_t *len);
+
+/**
+ * @brief Release the memory mapping of the partition.
+ */
+void littlefs_esp_part_munmap(esp_littlefs_t * efs);
+
 /**
  * @brief Read a region in a block, only for use with an mmapped partition.
  *
@@ -110,6 +441,20 @@ int littlefs_esp_part_read_mmap(const struct lfs_config *c, lfs_block_t block,
                            lfs_off_t off, void *buffer, lfs_size_t size);
 #endif
 
+#ifdef CONFIG_LITTLEFS_MMAP_ZERO_COPY_READ
+/**
+ * @brief Drop-in replacement for lfs_file_read() on an mmapped partition.
+ *
+ * File data is copied straight from the mapped flash into the user buffer
+ * instead of going through the file cache. The first read in each block of
+ * the file goes through littlefs, which locates the block, as do reads of
+ * inline or not yet flushed data.
+ *
+ * @return Number of bytes read, or a negative littlefs error code.
+ */
+lfs_ssize_t littlefs_esp_part_file_read_mmap(esp_littlefs_t * efs, lfs_file_t *file, void *buffer, lfs_size_t size);
+#endif
+
 /**
  * @brief Read a region in a block.
  *
@@ -253,6 +598,317 @@ int littlefs_sdmmc_sync(const struct lfs_config *c);
 
 #endif // CONFIG_LITTLEFS_SDMMC_SUPPORT
 
+#ifdef CONFIG_LITTLEFS_RAM_SUPPORT
+
+/**
+ * @brief Read a region in a block of a RAM-backed filesystem.
+ *
+ * @return errorcode. 0 on success.
+ */
+int littlefs_ram_read(const struct lfs_config *c, lfs_block_t block,
+                      lfs_off_t off, void *buffer, lfs_size_t size);
+
+/**
+ * @brief Program a region in a block of a RAM-backed filesystem.
+ *
+ * @return errorcode. 0 on success.
+ */
+int littlefs_ram_write(const struct lfs_config *c, lfs_block_t block,
+                       lfs_off_t off, const void *buffer, lfs_size_t size);
+
+/**
+ * @brief Erase a block of a RAM-backed filesystem.
+ *
+ * RAM can be overwritten in place, so this leaves the block untouched.
+ *
+ * @return errorcode. 0 on success.
+ */
+int littlefs_ram_erase(const struct lfs_config *c, lfs_block_t block);
+
+/**
+ * @brief Sync a RAM-backed filesystem; nothing to do.
+ *
+ * @return errorcode. 0 on success.
+ */
+int littlefs_ram_sync(const struct lfs_config *c);
+
+#endif // CONFIG_LITTLEFS_RAM_SUPPORT
+
+#ifdef CONFIG_LITTLEFS_OVERLAY
+
+/**
+ * @brief Stack the RAM write overlay on top of the partition callbacks in efs->cfg.
+ *
+ * Reserves the journal at the end of the partition, shrinking cfg.block_count,
+ * and finishes applying a checkpoint that was interrupted by a reset.
+ * Must be called after the backend has been set up and before mounting.
+ *
+ * @return ESP_OK on success.
+ */
+esp_err_t esp_littlefs_overlay_init(esp_littlefs_t *efs);
+
+/**
+ * @brief Start the task taking a checkpoint every CONFIG_LITTLEFS_OVERLAY_INTERVAL_MS.
+ *
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if the task could not be created.
+ */
+esp_err_t esp_littlefs_overlay_start(esp_littlefs_t *efs);
+
+/**
+ * @brief Stop the periodic checkpoint task, if running.
+ *
+ * Must not be called with efs->lock held.
+ */
+void esp_littlefs_overlay_stop(esp_littlefs_t *efs);
+
+/**
+ * @brief Write everything held by the overlay to flash, atomically.
+ *
+ * Takes efs->lock. A no-op if the overlay is not in use.
+ *
+ * @return errorcode. 0 on success.
+ */
+int esp_littlefs_overlay_checkpoint(esp_littlefs_t *efs);
+
+/**
+ * @brief Take a final checkpoint, restore the backend callbacks and free the overlay.
+ */
+void esp_littlefs_overlay_deinit(esp_littlefs_t *efs);
+
+/**
+ * @brief Whether flash doesn't hold the latest contents of a block, because the overlay does.
+ */
+bool esp_littlefs_overlay_holds(esp_littlefs_t *efs, lfs_block_t block);
+
+#endif // CONFIG_LITTLEFS_OVERLAY
+
+#ifdef CONFIG_LITTLEFS_BLOCK_CACHE
+
+/**
+ * @brief Stack the block cache on top of the backend callbacks in efs->cfg.
+ *
+ * Must be called after the backend has been set up and before mounting.
+ *
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if the slots could not be allocated.
+ */
+esp_err_t esp_littlefs_block_cache_init(esp_littlefs_t *efs);
+
+/**
+ * @brief Write back all dirty slots, restore the backend callbacks and free the slots.
+ */
+void esp_littlefs_block_cache_deinit(esp_littlefs_t *efs);
+
+/**
+ * @brief Drop all cached blocks, including dirty ones.
+ *
+ * For use when the underlying media was modified without going through littlefs.
+ */
+void esp_littlefs_block_cache_invalidate(esp_littlefs_t *efs);
+
+/**
+ * @brief Whether the cache holds changes to a block that haven't reached the media yet.
+ */
+bool esp_littlefs_block_cache_is_dirty(esp_littlefs_t *efs, lfs_block_t block);
+
+#endif // CONFIG_LITTLEFS_BLOCK_CACHE
+
+/**
+ * @brief Allocate the arena a mount configuration asks for, if any.
+ *
+ * max_files/max_dirs get fixed pools. With CONFIG_LITTLEFS_ARENA and `arena`, the
+ * read, prog and lookahead buffers are handed to littlefs from the arena too; buffers
+ * already set in efs->cfg (e.g. DMA-capable SD card caches) are kept.
+ * Must be called after efs->cfg is set up and before formatting or mounting.
+ *
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if the arena could not be allocated.
+ */
+esp_err_t esp_littlefs_arena_init(esp_littlefs_t *efs, const esp_vfs_littlefs_conf_t *conf);
+
+/**
+ * @brief Free the arena. Everything allocated from it must have been freed or be unused.
+ */
+void esp_littlefs_arena_deinit(esp_littlefs_t *efs);
+
+/**
+ * @brief Allocate a zeroed object of a size class in O(1).
+ *
+ * Falls back to the heap (counted in the class' stats) when all slots are in use
+ * or the object is larger than a slot, and for mounts without an arena. Fixed pools
+ * don't: they return NULL with errno set to ENFILE, or ENAMETOOLONG if the object
+ * doesn't fit a slot. errno is ENOMEM if the heap allocation fails.
+ * Must be called with efs->lock held.
+ */
+void *esp_littlefs_arena_calloc(esp_littlefs_t *efs, esp_littlefs_arena_class_t cls, size_t size);
+
+/**
+ * @brief Free an object from esp_littlefs_arena_calloc(). NULL is ignored.
+ *
+ * Must be called with efs->lock held.
+ */
+void esp_littlefs_arena_free(esp_littlefs_t *efs, void *ptr);
+
+#ifdef CONFIG_LITTLEFS_PREERASE
+
+/**
+ * @brief Start the pre-erase task for a mounted filesystem.
+ *
+ * @param erase HAL erase callback the task uses to erase free blocks.
+ *
+ * @return ESP_OK on success, ESP_ERR_NO_MEM otherwise.
+ */
+esp_err_t esp_littlefs_preerase_start(esp_littlefs_t *efs, int (*erase)(const struct lfs_config *c, lfs_block_t block));
+
+/**
+ * @brief Stop the pre-erase task (if running) and free its state.
+ */
+void esp_littlefs_preerase_stop(esp_littlefs_t *efs);
+
+/**
+ * @brief Called by a HAL erase callback before erasing a block.
+ *
+ * @return true if the block was erased ahead of time and the erase can be skipped.
+ */
+bool littlefs_preerase_claim(esp_littlefs_t *efs, lfs_block_t block);
+
+/**
+ * @brief Called by a HAL prog callback before programming a block.
+ */
+void littlefs_preerase_note_prog(esp_littlefs_t *efs, lfs_block_t block);
+
+#if CONFIG_LITTLEFS_PREERASE_COALESCE_SIZE
+/**
+ * @brief Check whether an erase of `block` may be widened to [first, first + count).
+ *
+ * @return true if littlefs used none of the other blocks in the range when they were
+ *         last seen, and none of them is erased already.
+ */
+bool littlefs_preerase_can_coalesce(esp_littlefs_t *efs, lfs_block_t block, lfs_block_t first, lfs_size_t count);
+
+/**
+ * @brief Called by a HAL erase callback after widening the erase of `block` to
+ *        [first, first + count); adds the other blocks to the pool.
+ */
+void littlefs_preerase_note_coalesced(esp_littlefs_t *efs, lfs_block_t block, lfs_block_t first, lfs_size_t count);
+#endif
+
+#endif // CONFIG_LITTLEFS_PREERASE
+
+#ifdef CONFIG_LITTLEFS_FLASH_SIM
+/**
+ * @brief Wrap the backend read/prog/erase callbacks in efs->cfg with the flash timing model.
+ *
+ * Must be called right after the backend callbacks are set up, before any other layer is stacked on top.
+ */
+void esp_littlefs_flash_sim_init(esp_littlefs_t *efs);
+
+/**
+ * @brief Charge the modelled time of erasing [addr, addr + size) of the flash.
+ *
+ * Called by the partition erase callback for each erase that reaches the flash.
+ */
+void littlefs_flash_sim_note_erase(esp_littlefs_t *efs, size_t addr, size_t size);
+#endif
+
+#ifdef CONFIG_LITTLEFS_WEAR_TRACKING
+/**
+ * @brief Allocate the erase counters of a mounted filesystem and load the saved ones.
+ */
+esp_err_t esp_littlefs_wear_init(esp_littlefs_t *efs);
+
+/**
+ * @brief Save (if persisted) and free the erase counters.
+ */
+void esp_littlefs_wear_deinit(esp_littlefs_t *efs);
+
+/**
+ * @brief Save the erase counters to NVS, if persisted.
+ *
+ * Saves only once CONFIG_LITTLEFS_WEAR_PERSIST_INTERVAL erases were counted
+ * since the last save, unless `force` is set. Called outside of the HAL.
+ * @warning This must be called with lock taken
+ */
+void esp_littlefs_wear_save(esp_littlefs_t *efs, bool force);
+
+/**
+ * @brief Called by a HAL erase callback for each erase littlefs requests.
+ */
+void littlefs_wear_note_erase(esp_littlefs_t *efs, lfs_block_t block, lfs_size_t count);
+
+/**
+ * @brief Summarize the erase counters.
+ */
+void esp_littlefs_wear_get_stats(esp_littlefs_t *efs, esp_littlefs_wear_stats_t *stats);
+#endif
+
+#ifdef CONFIG_LITTLEFS_IO_STATS
+/**
+ * @brief Wrap the backend callbacks in efs->cfg with the I/O counters.
+ *
+ * Must be called once the backend callbacks are set up, before the block cache is stacked on top.
+ */
+void esp_littlefs_io_stats_init(esp_littlefs_t *efs);
+
+/**
+ * @brief Call a HAL erase callback and count it as an erase.
+ *
+ * For erases that don't go through efs->cfg.erase, like the pre-erase task's.
+ */
+int littlefs_io_stats_erase_with(esp_littlefs_t *efs, int (*erase)(const struct lfs_config *c, lfs_block_t block),
+                                 lfs_block_t block);
+#endif
+
+#ifdef CONFIG_LITTLEFS_READAHEAD
+
+/**
+ * @brief Read through the read-ahead window.
+ *
+ * Reads that continue a sequential stream are served from, or refill,
+ * the window; all other reads go straight to \p raw_read.
+ *
+ * @param dev_size Size of the device in bytes; the window never extends past it.
+ *
+ * @return errorcode. 0 on success.
+ */
+int littlefs_readahead_read(const struct lfs_config *c, uint64_t addr, void *buffer, size_t size,
+                            uint64_t dev_size, esp_littlefs_raw_read_t raw_read);
+
+/**
+ * @brief Drop the read-ahead window if it overlaps a region that is being programmed or erased.
+ */
+void littlefs_readahead_invalidate(esp_littlefs_t *efs, uint64_t addr, size_t size);
+
+#endif // CONFIG_LITTLEFS_READAHEAD
+
+#if CONFIG_LITTLEFS_ERASE_POLICY_DEFERRED
+
+/**
+ * @brief Queue a block for a deferred discard instead of erasing it now.
+ *
+ * Adjacent blocks are merged into a single range. If the queue is full,
+ * it is flushed through \p discard first.
+ *
+ * @return errorcode. 0 on success.
+ */
+int littlefs_erase_queue_push(const struct lfs_config *c, lfs_block_t block, esp_littlefs_discard_t discard);
+
+/**
+ * @brief Drop a block from the deferred discard queue.
+ *
+ * Must be called before a block is programmed, so a later flush can't discard fresh data.
+ *
+ * @return errorcode. 0 on success.
+ */
+int littlefs_erase_queue_cancel(const struct lfs_config *c, lfs_block_t block, esp_littlefs_discard_t discard);
+
+/**
+ * @brief Issue all queued discards, one \p discard call per contiguous range.
+ *
+ * @return errorcode. 0 on success.
+ */
+int littlefs_erase_queue_flush(const struct lfs_config *c, esp_littlefs_discard_t discard);
+
+#endif // CONFIG_LITTLEFS_ERASE_POLICY_DEFERRED
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,203 @@
+/**
+ * @file littlefs_arena.c
+ * @brief Per-mount arena for open files, directories and littlefs buffers
+ *
+ * One allocation, made at mount time, is carved into a pool of fixed-size
+ * slots per size class. Free slots of a class are kept on an intrusive
+ * singly linked list, so allocating and freeing are O(1) and a long running
+ * mount doesn't fragment the heap.
+ *
+ * A mount gets an arena when it sets max_files/max_dirs, whose pools are
+ * fixed: they never fall back to the heap. With CONFIG_LITTLEFS_ARENA, the
+ * `arena` option adds pools that do fall back to the heap when full, and
+ * hands the read, prog and lookahead buffers to littlefs through efs->cfg,
+ * so littlefs never calls lfs_malloc() for such a mount.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <sys/param.h>
+#include "esp_log.h"
+#include "littlefs_api.h"
+
+#define ARENA_ALIGN 8
+
+static size_t arena_round(size_t size)
+{
+    return (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+static void *pool_pop(esp_littlefs_arena_pool_t *pool)
+{
+    void *slot = pool->free;
+    if (slot) {
+        memcpy(&pool->free, slot, sizeof(void *));
+        pool->stats.in_use++;
+        pool->stats.high_water = MAX(pool->stats.high_water, pool->stats.in_use);
+    }
+    return slot;
+}
+
+static void pool_push(esp_littlefs_arena_pool_t *pool, void *slot)
+{
+    memcpy(slot, &pool->free, sizeof(void *));
+    pool->free = slot;
+    pool->stats.in_use--;
+}
+
+esp_err_t esp_littlefs_arena_init(esp_littlefs_t *efs, const esp_vfs_littlefs_conf_t *conf)
+{
+    esp_littlefs_arena_t *arena = &efs->arena;
+    size_t slot_size[ESP_LITTLEFS_ARENA_CLASSES];
+    size_t slots[ESP_LITTLEFS_ARENA_CLASSES] = {0};
+    bool buffers = false;
+
+    memset(arena, 0, sizeof(*arena));
+
+#ifdef CONFIG_LITTLEFS_ARENA
+    if (conf->arena) {
+        buffers = true;
+        slots[ESP_LITTLEFS_ARENA_FILE] = conf->arena_files ? conf->arena_files : CONFIG_LITTLEFS_ARENA_FILES;
+        slots[ESP_LITTLEFS_ARENA_DIR] = conf->arena_dirs ? conf->arena_dirs : CONFIG_LITTLEFS_ARENA_DIRS;
+    }
+#endif
+    if (conf->max_files) {
+        slots[ESP_LITTLEFS_ARENA_FILE] = conf->max_files;
+        arena->pools[ESP_LITTLEFS_ARENA_FILE].fixed = true;
+    }
+    if (conf->max_dirs) {
+        slots[ESP_LITTLEFS_ARENA_DIR] = conf->max_dirs;
+        arena->pools[ESP_LITTLEFS_ARENA_DIR].fixed = true;
+    }
+    if (!buffers && !conf->max_files && !conf->max_dirs) {
+        return ESP_OK;
+    }
+
+    /* Open files carry their cache, so the mount's cache_size must be final by now */
+#ifdef CONFIG_LITTLEFS_USE_ONLY_HASH
+    slot_size[ESP_LITTLEFS_ARENA_FILE] = sizeof(vfs_littlefs_file_t) + efs->cfg.cache_size;
+#else
+    slot_size[ESP_LITTLEFS_ARENA_FILE] = sizeof(vfs_littlefs_file_t) + efs->cfg.cache_size + CONFIG_LITTLEFS_ARENA_PATH_LEN;
+#endif
+    slot_size[ESP_LITTLEFS_ARENA_DIR] = sizeof(vfs_littlefs_dir_t) + CONFIG_LITTLEFS_ARENA_PATH_LEN;
+    slot_size[ESP_LITTLEFS_ARENA_CACHE] = efs->cfg.cache_size;
+    slot_size[ESP_LITTLEFS_ARENA_LOOKAHEAD] = efs->cfg.lookahead_size;
+
+    if (buffers) {
+        slots[ESP_LITTLEFS_ARENA_CACHE] = (efs->cfg.read_buffer ? 0 : 1) + (efs->cfg.prog_buffer ? 0 : 1);
+        slots[ESP_LITTLEFS_ARENA_LOOKAHEAD] = efs->cfg.lookahead_buffer ? 0 : 1;
+    }
+
+    for (int i = 0; i < ESP_LITTLEFS_ARENA_CLASSES; i++) {
+        /* Every slot must be able to hold the free list link */
+        slot_size[i] = arena_round(MAX(slot_size[i], sizeof(void *)));
+        arena->size += slot_size[i] * slots[i];
+    }
+
+    arena->mem = esp_littlefs_calloc(1, arena->size);
+    if (arena->mem == NULL) {
+        ESP_LOGE(ESP_LITTLEFS_TAG, "arena of %u bytes could not be malloced", (unsigned)arena->size);
+        memset(arena, 0, sizeof(*arena));
+        return ESP_ERR_NO_MEM;
+    }
+
+    uint8_t *p = arena->mem;
+    for (int i = 0; i < ESP_LITTLEFS_ARENA_CLASSES; i++) {
+        esp_littlefs_arena_pool_t *pool = &arena->pools[i];
+        pool->base = p;
+        pool->stats.slots = slots[i];
+        pool->stats.slot_size = slot_size[i];
+        /* Thread the free list so the lowest slot is handed out first */
+        for (size_t n = slots[i]; n > 0; n--) {
+            void *slot = p + (n - 1) * slot_size[i];
+            memcpy(slot, &pool->free, sizeof(void *));
+            pool->free = slot;
+        }
+        p += slot_size[i] * slots[i];
+    }
+
+    esp_littlefs_arena_pool_t *cache = &arena->pools[ESP_LITTLEFS_ARENA_CACHE];
+    if (buffers && efs->cfg.read_buffer == NULL) {
+        efs->cfg.read_buffer = pool_pop(cache);
+    }
+    if (buffers && efs->cfg.prog_buffer == NULL) {
+        efs->cfg.prog_buffer = pool_pop(cache);
+    }
+    if (buffers && efs->cfg.lookahead_buffer == NULL) {
+        efs->cfg.lookahead_buffer = pool_pop(&arena->pools[ESP_LITTLEFS_ARENA_LOOKAHEAD]);
+    }
+
+    ESP_LOGD(ESP_LITTLEFS_TAG, "arena of %u bytes: %u files, %u dirs", (unsigned)arena->size,
+             (unsigned)slots[ESP_LITTLEFS_ARENA_FILE], (unsigned)slots[ESP_LITTLEFS_ARENA_DIR]);
+    return ESP_OK;
+}
+
+static bool arena_owns(const esp_littlefs_arena_t *arena, const void *ptr)
+{
+    return arena->mem && (const uint8_t *)ptr >= arena->mem && (const uint8_t *)ptr < arena->mem + arena->size;
+}
+
+void esp_littlefs_arena_deinit(esp_littlefs_t *efs)
+{
+    esp_littlefs_arena_t *arena = &efs->arena;
+
+    if (arena->mem == NULL) {
+        return;
+    }
+    if (arena_owns(arena, efs->cfg.read_buffer)) {
+        efs->cfg.read_buffer = NULL;
+    }
+    if (arena_owns(arena, efs->cfg.prog_buffer)) {
+        efs->cfg.prog_buffer = NULL;
+    }
+    if (arena_owns(arena, efs->cfg.lookahead_buffer)) {
+        efs->cfg.lookahead_buffer = NULL;
+    }
+    free(arena->mem);
+    memset(arena, 0, sizeof(*arena));
+}
+
+void *esp_littlefs_arena_calloc(esp_littlefs_t *efs, esp_littlefs_arena_class_t cls, size_t size)
+{
+    esp_littlefs_arena_t *arena = &efs->arena;
+    esp_littlefs_arena_pool_t *pool = &arena->pools[cls];
+    void *ptr;
+
+    if (arena->mem && size <= pool->stats.slot_size) {
+        ptr = pool_pop(pool);
+        if (ptr) {
+            memset(ptr, 0, size);
+            return ptr;
+        }
+    }
+    if (pool->fixed) {
+        errno = size > pool->stats.slot_size ? ENAMETOOLONG : ENFILE;
+        return NULL;
+    }
+    if (arena->mem) {
+        pool->stats.fallbacks++;
+    }
+    ptr = esp_littlefs_calloc(1, size);
+    if (ptr == NULL) {
+        errno = ENOMEM;
+    }
+    return ptr;
+}
+
+void esp_littlefs_arena_free(esp_littlefs_t *efs, void *ptr)
+{
+    esp_littlefs_arena_t *arena = &efs->arena;
+
+    if (!arena_owns(arena, ptr)) {
+        free(ptr);
+        return;
+    }
+    /* Pools are laid out in class order, the last one starting at or below ptr owns it */
+    for (int i = ESP_LITTLEFS_ARENA_CLASSES - 1; i >= 0; i--) {
+        esp_littlefs_arena_pool_t *pool = &arena->pools[i];
+        if ((uint8_t *)ptr >= pool->base && pool->stats.slots) {
+            pool_push(pool, ptr);
+            return;
+        }
+    }
+}
@@ -51,6 +51,53 @@ static bool validate_handle(const esp_blockdev_handle_t dev, const char *op)
     return true;
 }
 
+#if CONFIG_LITTLEFS_ERASE_POLICY_DEFERRED
+/* Issue a queued logical-mode erase for a contiguous range of blocks */
+static int littlefs_bdl_discard(const struct lfs_config *c, lfs_block_t start, lfs_size_t count)
+{
+    esp_littlefs_t *efs = (esp_littlefs_t *)c->context;
+    esp_blockdev_handle_t dev = efs->bdl_handle;
+    const uint64_t addr = (uint64_t)start * c->block_size;
+    const size_t erase_len = (size_t)count * c->block_size;
+
+    if (dev->geometry.disk_size && addr + erase_len > dev->geometry.disk_size) {
+        ESP_LOGE(ESP_LITTLEFS_TAG, "BDL discard out of range: addr=0x%016" PRIx64 ", len=0x%08x (disk_size=0x%016" PRIx64 ")",
+                 addr, (unsigned)erase_len, dev->geometry.disk_size);
+        return LFS_ERR_IO;
+    }
+
+#ifdef CONFIG_LITTLEFS_READAHEAD
+    littlefs_readahead_invalidate(efs, addr, erase_len);
+#endif
+
+    esp_err_t err = dev->ops->erase(dev, addr, erase_len);
+    if (err != ESP_OK) {
+        ESP_LOGE(ESP_LITTLEFS_TAG, "BDL discard failed: addr=0x%016" PRIx64 ", len=0x%08x, err=0x%x",
+                 addr, (unsigned)erase_len, err);
+    }
+#ifdef CONFIG_LITTLEFS_WEAR_TRACKING
+    if (err == ESP_OK) {
+        littlefs_wear_note_erase(efs, start, count);
+    }
+#endif
+    return esp_err_to_lfs(err);
+}
+#endif
+
+static int littlefs_bdl_read_raw(const struct lfs_config *c, uint64_t addr, void *buffer, size_t size)
+{
+    esp_littlefs_t *efs = (esp_littlefs_t *)c->context;
+    esp_blockdev_handle_t dev = efs->bdl_handle;
+
+    /* dst_buf_size == data_read_len because LittleFS always provides an exact-sized buffer */
+    esp_err_t err = dev->ops->read(dev, (uint8_t *)buffer, size, addr, size);
+    if (err != ESP_OK) {
+        ESP_LOGE(ESP_LITTLEFS_TAG, "BDL read failed: addr=0x%016" PRIx64 ", size=0x%08x, err=0x%x",
+                 addr, (unsigned)size, err);
+    }
+    return esp_err_to_lfs(err);
+}
+
 int littlefs_bdl_read(const struct lfs_config *c, lfs_block_t block,
                       lfs_off_t off, void *buffer, lfs_size_t size)
 {
@@ -79,13 +126,13 @@ int littlefs_bdl_read(const struct lfs_config *c, lfs_block_t block,
         return LFS_ERR_IO;
     }
 
-    /* dst_buf_size == data_read_len because LittleFS always provides an exact-sized buffer */
-    esp_err_t err = dev->ops->read(dev, (uint8_t *)buffer, size, addr, size);
-    if (err != ESP_OK) {
-        ESP_LOGE(ESP_LITTLEFS_TAG, "BDL read failed: addr=0x%016" PRIx64 ", size=0x%08x, err=0x%x",
-                 addr, (unsigned)size, err);
-    }
-    return esp_err_to_lfs(err);
+#ifdef CONFIG_LITTLEFS_READAHEAD
+    const uint64_t dev_size = dev->geometry.disk_size ? dev->geometry.disk_size
+                                                      : (uint64_t)c->block_count * c->block_size;
+    return littlefs_readahead_read(c, addr, buffer, size, dev_size, littlefs_bdl_read_raw);
+#else
+    return littlefs_bdl_read_raw(c, addr, buffer, size);
+#endif
 }
 
 int littlefs_bdl_write(const struct lfs_config *c, lfs_block_t block,
@@ -120,6 +167,23 @@ int littlefs_bdl_write(const struct lfs_config *c, lfs_block_t block,
         return LFS_ERR_IO;
     }
 
+#if CONFIG_LITTLEFS_ERASE_POLICY_DEFERRED
+    if (efs->bdl_logical_block_mode) {
+        int res = littlefs_erase_queue_cancel(c, block, littlefs_bdl_discard);
+        if (res != LFS_ERR_OK) {
+            return res;
+        }
+    }
+#endif
+
+#ifdef CONFIG_LITTLEFS_PREERASE
+    littlefs_preerase_note_prog(efs, block);
+#endif
+
+#ifdef CONFIG_LITTLEFS_READAHEAD
+    littlefs_readahead_invalidate(efs, addr, size);
+#endif
+
     esp_err_t err = dev->ops->write(dev, (const uint8_t *)buffer, addr, size);
     if (err != ESP_OK) {
         ESP_LOGE(ESP_LITTLEFS_TAG, "BDL write failed: addr=0x%016" PRIx64 ", size=0x%08x, err=0x%x",
@@ -145,10 +209,25 @@ int littlefs_bdl_erase(const struct lfs_config *c, lfs_block_t block)
     const size_t erase_len = c->block_size;
     const bool logical = efs && efs->bdl_logical_block_mode;
 
+#ifdef CONFIG_LITTLEFS_PREERASE
+    if (littlefs_preerase_claim(efs, block)) {
+        return LFS_ERR_OK;
+    }
+#endif
+
     /*
      * Logical BDL mode (erase_before_write=0): LittleFS block_size may be smaller than geometry.erase_size.
-     * Skip alignment to geometry.erase_size; erase operation is still required for LittleFS compatibility.
+     * Skip alignment to geometry.erase_size. The media can be overwritten, so the erase itself is
+     * subject to CONFIG_LITTLEFS_ERASE_POLICY: LittleFS never reads a block it hasn't programmed
+     * since erasing it except to look for the end of a metadata log, and stale bytes there fail
+     * the commit CRC just like erased ones would.
      */
+#if CONFIG_LITTLEFS_ERASE_POLICY_SKIP
+    if (logical) {
+        return LFS_ERR_OK;
+    }
+#endif
+
     if (!dev->ops->erase) {
         ESP_LOGE(ESP_LITTLEFS_TAG, "BDL erase not supported (missing erase op)");
         return LFS_ERR_IO;
@@ -177,11 +256,26 @@ int littlefs_bdl_erase(const struct lfs_config *c, lfs_block_t block)
         return LFS_ERR_IO;
     }
 
+#if CONFIG_LITTLEFS_ERASE_POLICY_DEFERRED
+    if (logical) {
+        return littlefs_erase_queue_push(c, block, littlefs_bdl_discard);
+    }
+#endif
+
+#ifdef CONFIG_LITTLEFS_READAHEAD
+    littlefs_readahead_invalidate(efs, addr, erase_len);
+#endif
+
     esp_err_t err = dev->ops->erase(dev, addr, erase_len);
     if (err != ESP_OK) {
         ESP_LOGE(ESP_LITTLEFS_TAG, "BDL erase failed: addr=0x%016" PRIx64 ", len=0x%08x, err=0x%x",
                  addr, (unsigned)erase_len, err);
     }
+#ifdef CONFIG_LITTLEFS_WEAR_TRACKING
+    if (err == ESP_OK) {
+        littlefs_wear_note_erase(efs, block, 1);
+    }
+#endif
     return esp_err_to_lfs(err);
 }
 
@@ -193,6 +287,15 @@ int littlefs_bdl_sync(const struct lfs_config *c)
         return LFS_ERR_IO;
     }
 
+#if CONFIG_LITTLEFS_ERASE_POLICY_DEFERRED
+    if (efs->bdl_logical_block_mode && dev->ops->erase) {
+        int res = littlefs_erase_queue_flush(c, littlefs_bdl_discard);
+        if (res != LFS_ERR_OK) {
+            return res;
+        }
+    }
+#endif
+
     if (!dev->ops->sync) {
         return LFS_ERR_OK; /* Nothing to do */
     }
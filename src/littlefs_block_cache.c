@@ -0,0 +1,350 @@
+/**
+ * @file littlefs_block_cache.c
+ * @brief Write-back block cache stacked between littlefs and a backend HAL
+ *
+ * Installs itself in place of the read/prog/erase/sync callbacks of an
+ * initialized esp_littlefs_t and forwards to the saved backend callbacks.
+ *
+ * Each slot holds one whole block. Slots are replaced with the CLOCK algorithm.
+ * Progs and erases are buffered in the slot and written back at sync, on eviction,
+ * or earlier when needed to keep device writes in the order littlefs issued them:
+ *   - a slot's dirty bytes always form one contiguous range;
+ *   - if a dirty slot is written to after another slot was dirtied, all dirty
+ *     slots are written back (oldest first) before the new write is buffered.
+ */
+
+#include <string.h>
+#include <sys/param.h>
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "littlefs_api.h"
+
+#ifdef CONFIG_LITTLEFS_BLOCK_CACHE
+
+static inline bool slot_is_dirty(const esp_littlefs_cache_slot_t *slot)
+{
+    return slot->erase_pending || slot->dirty_end > slot->dirty_start;
+}
+
+static esp_littlefs_cache_slot_t *cache_lookup(esp_littlefs_block_cache_t *bc, lfs_block_t block)
+{
+    for (size_t i = 0; i < CONFIG_LITTLEFS_BLOCK_CACHE_SLOTS; i++) {
+        esp_littlefs_cache_slot_t *slot = &bc->slots[i];
+        if (slot->valid && slot->block == block) {
+            return slot;
+        }
+    }
+    return NULL;
+}
+
+static int cache_writeback(const struct lfs_config *c, esp_littlefs_cache_slot_t *slot)
+{
+    esp_littlefs_t *efs = c->context;
+    esp_littlefs_block_cache_t *bc = &efs->bcache;
+    int res;
+
+    if (slot->erase_pending) {
+        res = bc->backend_erase(c, slot->block);
+        if (res != LFS_ERR_OK) {
+            return res;
+        }
+        slot->erase_pending = false;
+    }
+
+    if (slot->dirty_end > slot->dirty_start) {
+        res = bc->backend_prog(c, slot->block, slot->dirty_start,
+                               &slot->data[slot->dirty_start], slot->dirty_end - slot->dirty_start);
+        if (res != LFS_ERR_OK) {
+            return res;
+        }
+        bc->writebacks++;
+    }
+
+    slot->dirty_start = slot->dirty_end = 0;
+    if (bc->last_dirty == slot) {
+        bc->last_dirty = NULL;
+    }
+    return LFS_ERR_OK;
+}
+
+/* Write back every dirty slot in the order it was first dirtied */
+static int cache_flush(const struct lfs_config *c)
+{
+    esp_littlefs_t *efs = c->context;
+    esp_littlefs_block_cache_t *bc = &efs->bcache;
+
+    for (;;) {
+        esp_littlefs_cache_slot_t *oldest = NULL;
+        for (size_t i = 0; i < CONFIG_LITTLEFS_BLOCK_CACHE_SLOTS; i++) {
+            esp_littlefs_cache_slot_t *slot = &bc->slots[i];
+            if (slot->valid && slot_is_dirty(slot) &&
+                    (oldest == NULL || (int32_t)(slot->dirty_seq - oldest->dirty_seq) < 0)) {
+                oldest = slot;
+            }
+        }
+        if (oldest == NULL) {
+            return LFS_ERR_OK;
+        }
+        int res = cache_writeback(c, oldest);
+        if (res != LFS_ERR_OK) {
+            return res;
+        }
+    }
+}
+
+/* Pick a slot to (re)use with the CLOCK algorithm, writing it back if necessary */
+static int cache_evict(const struct lfs_config *c, esp_littlefs_cache_slot_t **out)
+{
+    esp_littlefs_t *efs = c->context;
+    esp_littlefs_block_cache_t *bc = &efs->bcache;
+    esp_littlefs_cache_slot_t *victim = NULL;
+
+    /* Two sweeps clear every reference bit, so a victim is always found */
+    for (size_t n = 0; n < 2 * CONFIG_LITTLEFS_BLOCK_CACHE_SLOTS; n++) {
+        esp_littlefs_cache_slot_t *slot = &bc->slots[bc->hand];
+        bc->hand = (bc->hand + 1) % CONFIG_LITTLEFS_BLOCK_CACHE_SLOTS;
+        if (!slot->valid) {
+            victim = slot;
+            break;
+        }
+        if (slot->referenced) {
+            slot->referenced = false;
+            continue;
+        }
+        victim = slot;
+        break;
+    }
+
+    if (slot_is_dirty(victim)) {
+        /* Older dirty slots must reach the device before this one */
+        int res = cache_flush(c);
+        if (res != LFS_ERR_OK) {
+            return res;
+        }
+    }
+
+    victim->valid = false;
+    *out = victim;
+    return LFS_ERR_OK;
+}
+
+/* Find or load the slot holding `block` */
+static int cache_get(const struct lfs_config *c, lfs_block_t block, bool fill, esp_littlefs_cache_slot_t **out)
+{
+    esp_littlefs_t *efs = c->context;
+    esp_littlefs_block_cache_t *bc = &efs->bcache;
+    esp_littlefs_cache_slot_t *slot = cache_lookup(bc, block);
+
+    if (slot == NULL) {
+        int res = cache_evict(c, &slot);
+        if (res != LFS_ERR_OK) {
+            return res;
+        }
+        if (fill) {
+            res = bc->backend_read(c, block, 0, slot->data, c->block_size);
+            if (res != LFS_ERR_OK) {
+                return res;
+            }
+        }
+        slot->block = block;
+        slot->valid = true;
+        slot->erase_pending = false;
+        slot->dirty_start = slot->dirty_end = 0;
+    }
+
+    slot->referenced = true;
+    *out = slot;
+    return LFS_ERR_OK;
+}
+
+/* Make `slot` the most recently dirtied slot, preserving device write order */
+static int cache_mark_dirty(const struct lfs_config *c, esp_littlefs_cache_slot_t *slot)
+{
+    esp_littlefs_t *efs = c->context;
+    esp_littlefs_block_cache_t *bc = &efs->bcache;
+
+    if (bc->last_dirty == slot) {
+        return LFS_ERR_OK;
+    }
+    if (slot_is_dirty(slot)) {
+        /* Another slot was written in between; don't let this one overtake it */
+        int res = cache_flush(c);
+        if (res != LFS_ERR_OK) {
+            return res;
+        }
+    }
+    slot->dirty_seq = ++bc->seq;
+    bc->last_dirty = slot;
+    return LFS_ERR_OK;
+}
+
+static int littlefs_block_cache_read(const struct lfs_config *c, lfs_block_t block,
+                                     lfs_off_t off, void *buffer, lfs_size_t size)
+{
+    esp_littlefs_t *efs = c->context;
+    esp_littlefs_block_cache_t *bc = &efs->bcache;
+    esp_littlefs_cache_slot_t *slot = cache_lookup(bc, block);
+
+    if (slot) {
+        bc->hits++;
+        slot->referenced = true;
+        memcpy(buffer, &slot->data[off], size);
+        return LFS_ERR_OK;
+    }
+
+    bc->misses++;
+
+    /* Large reads are bulk file data littlefs reads straight into the user's
+     * buffer; don't let them flush metadata blocks out of the cache. */
+    if (size > c->cache_size) {
+        return bc->backend_read(c, block, off, buffer, size);
+    }
+
+    int res = cache_get(c, block, true, &slot);
+    if (res != LFS_ERR_OK) {
+        return res;
+    }
+    memcpy(buffer, &slot->data[off], size);
+    return LFS_ERR_OK;
+}
+
+static int littlefs_block_cache_prog(const struct lfs_config *c, lfs_block_t block,
+                                     lfs_off_t off, const void *buffer, lfs_size_t size)
+{
+    esp_littlefs_cache_slot_t *slot;
+
+    int res = cache_get(c, block, true, &slot);
+    if (res != LFS_ERR_OK) {
+        return res;
+    }
+
+    res = cache_mark_dirty(c, slot);
+    if (res != LFS_ERR_OK) {
+        return res;
+    }
+
+    /* Keep the dirty range contiguous so write-back never reprograms untouched bytes */
+    if (slot->dirty_end > slot->dirty_start && (off > slot->dirty_end || off + size < slot->dirty_start)) {
+        res = cache_flush(c);
+        if (res != LFS_ERR_OK) {
+            return res;
+        }
+        res = cache_mark_dirty(c, slot);
+        if (res != LFS_ERR_OK) {
+            return res;
+        }
+    }
+
+    memcpy(&slot->data[off], buffer, size);
+    if (slot->dirty_end > slot->dirty_start) {
+        slot->dirty_start = MIN(slot->dirty_start, off);
+        slot->dirty_end = MAX(slot->dirty_end, off + size);
+    } else {
+        slot->dirty_start = off;
+        slot->dirty_end = off + size;
+    }
+    return LFS_ERR_OK;
+}
+
+static int littlefs_block_cache_erase(const struct lfs_config *c, lfs_block_t block)
+{
+    esp_littlefs_cache_slot_t *slot;
+
+    /* No need to read in a block that's about to be erased */
+    int res = cache_get(c, block, false, &slot);
+    if (res != LFS_ERR_OK) {
+        return res;
+    }
+
+    res = cache_mark_dirty(c, slot);
+    if (res != LFS_ERR_OK) {
+        return res;
+    }
+
+    /* Anything buffered for this block is superseded by the erase */
+    memset(slot->data, 0xFF, c->block_size);
+    slot->dirty_start = slot->dirty_end = 0;
+    slot->erase_pending = true;
+    return LFS_ERR_OK;
+}
+
+static int littlefs_block_cache_sync(const struct lfs_config *c)
+{
+    esp_littlefs_t *efs = c->context;
+
+    int res = cache_flush(c);
+    if (res != LFS_ERR_OK) {
+        return res;
+    }
+    return efs->bcache.backend_sync(c);
+}
+
+esp_err_t esp_littlefs_block_cache_init(esp_littlefs_t *efs)
+{
+    esp_littlefs_block_cache_t *bc = &efs->bcache;
+
+    for (size_t i = 0; i < CONFIG_LITTLEFS_BLOCK_CACHE_SLOTS; i++) {
+        bc->slots[i].data = heap_caps_malloc_prefer(efs->cfg.block_size, 2,
+                                                    MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT,
+                                                    MALLOC_CAP_DEFAULT);
+        if (bc->slots[i].data == NULL) {
+            ESP_LOGE(ESP_LITTLEFS_TAG, "block cache slot could not be malloced");
+            esp_littlefs_block_cache_deinit(efs);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    bc->backend_read  = efs->cfg.read;
+    bc->backend_prog  = efs->cfg.prog;
+    bc->backend_erase = efs->cfg.erase;
+    bc->backend_sync  = efs->cfg.sync;
+
+    efs->cfg.read  = littlefs_block_cache_read;
+    efs->cfg.prog  = littlefs_block_cache_prog;
+    efs->cfg.erase = littlefs_block_cache_erase;
+    efs->cfg.sync  = littlefs_block_cache_sync;
+
+    return ESP_OK;
+}
+
+void esp_littlefs_block_cache_deinit(esp_littlefs_t *efs)
+{
+    esp_littlefs_block_cache_t *bc = &efs->bcache;
+
+    if (bc->backend_read) {
+        if (cache_flush(&efs->cfg) != LFS_ERR_OK) {
+            ESP_LOGE(ESP_LITTLEFS_TAG, "failed to write back block cache");
+        }
+        efs->cfg.read  = bc->backend_read;
+        efs->cfg.prog  = bc->backend_prog;
+        efs->cfg.erase = bc->backend_erase;
+        efs->cfg.sync  = bc->backend_sync;
+    }
+
+    for (size_t i = 0; i < CONFIG_LITTLEFS_BLOCK_CACHE_SLOTS; i++) {
+        free(bc->slots[i].data);
+    }
+    memset(bc, 0, sizeof(*bc));
+}
+
+void esp_littlefs_block_cache_invalidate(esp_littlefs_t *efs)
+{
+    esp_littlefs_block_cache_t *bc = &efs->bcache;
+
+    for (size_t i = 0; i < CONFIG_LITTLEFS_BLOCK_CACHE_SLOTS; i++) {
+        esp_littlefs_cache_slot_t *slot = &bc->slots[i];
+        slot->valid = false;
+        slot->referenced = false;
+        slot->erase_pending = false;
+        slot->dirty_start = slot->dirty_end = 0;
+    }
+    bc->last_dirty = NULL;
+}
+
+bool esp_littlefs_block_cache_is_dirty(esp_littlefs_t *efs, lfs_block_t block)
+{
+    const esp_littlefs_cache_slot_t *slot = cache_lookup(&efs->bcache, block);
+    return slot && slot_is_dirty(slot);
+}
+
+#endif // CONFIG_LITTLEFS_BLOCK_CACHE
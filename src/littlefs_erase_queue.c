@@ -0,0 +1,139 @@
+/**
+ * @file littlefs_erase_queue.c
+ * @brief Deferred, coalescing discard queue for overwrite-capable backends
+ *
+ * SD cards and logical-mode block devices don't need a block to be erased before
+ * it is programmed. Instead of paying one erase command per block, erased blocks
+ * are queued as sorted, non-overlapping ranges and discarded in bulk at sync time.
+ * A block that gets programmed while queued is removed from the queue first.
+ */
+
+#include <string.h>
+#include "esp_log.h"
+#include "littlefs_api.h"
+
+#if CONFIG_LITTLEFS_ERASE_POLICY_DEFERRED
+
+static void erase_queue_remove(esp_littlefs_t *efs, size_t i)
+{
+    memmove(&efs->erase_queue[i], &efs->erase_queue[i + 1],
+            (efs->erase_queue_len - i - 1) * sizeof(efs->erase_queue[0]));
+    efs->erase_queue_len--;
+}
+
+static void erase_queue_insert(esp_littlefs_t *efs, size_t i, lfs_block_t start, lfs_size_t count)
+{
+    memmove(&efs->erase_queue[i + 1], &efs->erase_queue[i],
+            (efs->erase_queue_len - i) * sizeof(efs->erase_queue[0]));
+    efs->erase_queue[i].start = start;
+    efs->erase_queue[i].count = count;
+    efs->erase_queue_len++;
+}
+
+int littlefs_erase_queue_flush(const struct lfs_config *c, esp_littlefs_discard_t discard)
+{
+    esp_littlefs_t *efs = c->context;
+    int res = LFS_ERR_OK;
+
+    while (efs->erase_queue_len > 0) {
+        const esp_littlefs_erase_range_t *r = &efs->erase_queue[0];
+        int err = discard(c, r->start, r->count);
+        if (err != LFS_ERR_OK) {
+            ESP_LOGE(ESP_LITTLEFS_TAG, "Deferred discard of blocks %lu+%lu failed (%d)",
+                     (unsigned long)r->start, (unsigned long)r->count, err);
+            /* Report the first failure, later successes don't undo it */
+            if (res == LFS_ERR_OK) {
+                res = err;
+            }
+        }
+        /* Drop the range either way so a failing range can't wedge the queue */
+        erase_queue_remove(efs, 0);
+    }
+    return res;
+}
+
+int littlefs_erase_queue_push(const struct lfs_config *c, lfs_block_t block, esp_littlefs_discard_t discard)
+{
+    esp_littlefs_t *efs = c->context;
+    size_t i;
+
+    /* Find the first range that ends at or after `block` */
+    for (i = 0; i < efs->erase_queue_len; i++) {
+        const esp_littlefs_erase_range_t *r = &efs->erase_queue[i];
+        if (r->start + r->count >= block) {
+            break;
+        }
+    }
+
+    if (i < efs->erase_queue_len) {
+        esp_littlefs_erase_range_t *r = &efs->erase_queue[i];
+        if (block >= r->start && block < r->start + r->count) {
+            return LFS_ERR_OK; /* Already queued */
+        }
+        if (block == r->start + r->count) {
+            r->count++;
+            /* Bridge the gap to the next range */
+            if (i + 1 < efs->erase_queue_len && efs->erase_queue[i + 1].start == block + 1) {
+                r->count += efs->erase_queue[i + 1].count;
+                erase_queue_remove(efs, i + 1);
+            }
+            return LFS_ERR_OK;
+        }
+        if (block + 1 == r->start) {
+            r->start--;
+            r->count++;
+            return LFS_ERR_OK;
+        }
+    }
+
+    if (efs->erase_queue_len == CONFIG_LITTLEFS_ERASE_QUEUE_LEN) {
+        int res = littlefs_erase_queue_flush(c, discard);
+        if (res != LFS_ERR_OK) {
+            return res;
+        }
+        i = 0;
+    }
+
+    erase_queue_insert(efs, i, block, 1);
+    return LFS_ERR_OK;
+}
+
+int littlefs_erase_queue_cancel(const struct lfs_config *c, lfs_block_t block, esp_littlefs_discard_t discard)
+{
+    esp_littlefs_t *efs = c->context;
+
+    for (size_t i = 0; i < efs->erase_queue_len; i++) {
+        esp_littlefs_erase_range_t *r = &efs->erase_queue[i];
+        if (block < r->start) {
+            break;
+        }
+        if (block >= r->start + r->count) {
+            continue;
+        }
+
+        const lfs_block_t end = r->start + r->count;
+        if (block == r->start) {
+            r->start++;
+            r->count--;
+            if (r->count == 0) {
+                erase_queue_remove(efs, i);
+            }
+        } else if (block == end - 1) {
+            r->count--;
+        } else if (efs->erase_queue_len < CONFIG_LITTLEFS_ERASE_QUEUE_LEN) {
+            /* Split the range around `block` */
+            r->count = block - r->start;
+            erase_queue_insert(efs, i + 1, block + 1, end - block - 1);
+        } else {
+            /* No room to split; discard the lower half right away */
+            int res = discard(c, r->start, block - r->start);
+            r->start = block + 1;
+            r->count = end - block - 1;
+            return res;
+        }
+        return LFS_ERR_OK;
+    }
+    return LFS_ERR_OK;
+}
+
+#endif // CONFIG_LITTLEFS_ERASE_POLICY_DEFERRED
@@ -6,6 +6,7 @@
 
 //#define ESP_LOCAL_LOG_LEVEL ESP_LOG_INFO
 
+#include <sys/param.h>
 #include "esp_log.h"
 #include "esp_partition.h"
 #include "esp_vfs.h"
@@ -17,35 +18,217 @@
 #include "esp_task_wdt.h"
 #endif
 
+#ifdef CONFIG_LITTLEFS_MMAP_PARTITION
+const uint8_t *littlefs_esp_part_mmap(esp_littlefs_t * efs, size_t part_off, size_t *len) {
+#if CONFIG_LITTLEFS_MMAP_WINDOWS
+    /* Windows are aligned on the flash address, so each one takes exactly one MMU page */
+    const size_t addr = efs->partition->address;
+    const size_t page = (addr + part_off) & ~(size_t)(ESP_LITTLEFS_MMAP_WINDOW_SIZE - 1);
+    const size_t start = page < addr ? 0 : page - addr;
+    const size_t end = MIN(page + ESP_LITTLEFS_MMAP_WINDOW_SIZE - addr, efs->partition->size);
+    *len = MIN(*len, end - part_off);
+
+    esp_littlefs_mmap_window_t *victim = &efs->mmap_windows[0];
+    for (size_t i = 0; i < CONFIG_LITTLEFS_MMAP_WINDOWS; i++) {
+        esp_littlefs_mmap_window_t *w = &efs->mmap_windows[i];
+        if (w->data && w->offset == start) {
+            w->last_used = ++efs->mmap_tick;
+            return w->data + (part_off - start);
+        }
+        if (victim->data && (w->data == NULL || w->last_used < victim->last_used)) {
+            victim = w;
+        }
+    }
+
+    /* Miss: replace the least recently used window */
+    if (victim->data) {
+        esp_partition_munmap(victim->handle);
+        victim->data = NULL;
+    }
+    const void *data;
+    esp_err_t err = esp_partition_mmap(efs->partition, start, end - start,
+                                       SPI_FLASH_MMAP_DATA, &data, &victim->handle);
+    if (err != ESP_OK) {
+        ESP_LOGV(ESP_LITTLEFS_TAG, "failed to map window at %08x, err %d", (unsigned int)start, err);
+        return NULL;
+    }
+    victim->data = data;
+    victim->offset = start;
+    victim->last_used = ++efs->mmap_tick;
+    return victim->data + (part_off - start);
+#else
+    return (const uint8_t *)efs->mmap_data + part_off;
+#endif
+}
+
+void littlefs_esp_part_munmap(esp_littlefs_t * efs) {
+#if CONFIG_LITTLEFS_MMAP_WINDOWS
+    for (size_t i = 0; i < CONFIG_LITTLEFS_MMAP_WINDOWS; i++) {
+        if (efs->mmap_windows[i].data) {
+            esp_partition_munmap(efs->mmap_windows[i].handle);
+            efs->mmap_windows[i].data = NULL;
+        }
+    }
+#else
+    if (efs->mmap_data) {
+        esp_partition_munmap(efs->mmap_handle);
+        efs->mmap_data = NULL;
+    }
+#endif
+}
+#endif
+
+#ifdef CONFIG_LITTLEFS_ERASE_BLANK_CHECK
+/**
+ * @brief Check whether a flash region already reads back as erased (all 0xFF).
+ *
+ * Uses the mmapped partition when possible; encrypted partitions are mmapped
+ * as plaintext, so those are checked with a raw (ciphertext) read instead.
+ */
+static bool littlefs_esp_part_is_blank(esp_littlefs_t * efs, size_t part_off, size_t size) {
+    uint32_t buf[64];
+    while (size > 0) {
+        size_t len = size;
+        const uint32_t *p = NULL;
+#ifdef CONFIG_LITTLEFS_MMAP_PARTITION
+        if (!efs->partition->encrypted) {
+            p = (const uint32_t *)littlefs_esp_part_mmap(efs, part_off, &len);
+        }
+#endif
+        if (p == NULL) {
+            len = MIN(sizeof(buf), size);
+            if (esp_partition_read_raw(efs->partition, part_off, buf, len) != ESP_OK) {
+                return false;
+            }
+            p = buf;
+        }
+        for (size_t i = 0; i < len / sizeof(uint32_t); i++) {
+            if (p[i] != UINT32_MAX) return false;
+        }
+        part_off += len;
+        size -= len;
+    }
+    return true;
+}
+#endif
+
 #ifdef CONFIG_LITTLEFS_MMAP_PARTITION
 int littlefs_esp_part_read_mmap(const struct lfs_config *c, lfs_block_t block,
                            lfs_off_t off, void *buffer, lfs_size_t size) {
     esp_littlefs_t * efs = c->context;
     size_t part_off = (block * c->block_size) + off;
+    uint8_t *data = buffer;
     if (part_off > efs->partition->size || part_off + size > efs->partition->size) {
         ESP_LOGE(ESP_LITTLEFS_TAG, "attempt to read out bounds of mmaped region %08x-%08x", (unsigned int)part_off, (unsigned int)(part_off + size));
         return LFS_ERR_IO;
     }
-    memcpy(buffer, efs->mmap_data + part_off, size);
+    while (size > 0) {
+        size_t len = size;
+        const uint8_t *src = littlefs_esp_part_mmap(efs, part_off, &len);
+        if (src) {
+            memcpy(data, src, len);
+        } else {
+            /* Out of MMU space; read through the flash driver instead */
+            esp_err_t err = esp_partition_read(efs->partition, part_off, data, len);
+            if (err) {
+                ESP_LOGE(ESP_LITTLEFS_TAG, "failed to read addr %08x, size %08x, err %d", (unsigned int) part_off, (unsigned int) len, err);
+                return LFS_ERR_IO;
+            }
+        }
+        data += len;
+        part_off += len;
+        size -= len;
+    }
     return 0;
 }
 #endif
 
+#ifdef CONFIG_LITTLEFS_MMAP_ZERO_COPY_READ
+/*
+ * The zero-copy read steps lfs_file_t's position by hand, which isn't part of
+ * littlefs's API. Check it against lfs_file_flushedread() before moving this on.
+ */
+#if LFS_VERSION < 0x00020009 || LFS_VERSION > 0x0002000b
+#error "CONFIG_LITTLEFS_MMAP_ZERO_COPY_READ hasn't been checked against this littlefs version"
+#endif
+
+lfs_ssize_t littlefs_esp_part_file_read_mmap(esp_littlefs_t * efs, lfs_file_t *file, void *buffer, lfs_size_t size) {
+    const lfs_size_t block_size = efs->cfg.block_size;
+    uint8_t *data = buffer;
+    lfs_size_t nread = 0;
+
+    /* Inline files live in metadata, and unflushed writes in the file cache; littlefs handles those */
+    if (file->flags & (LFS_F_WRITING | LFS_F_INLINE)) {
+        return lfs_file_read(efs->fs, file, buffer, size);
+    }
+
+    while (nread < size && file->pos < file->ctz.size) {
+        if (!(file->flags & LFS_F_READING) || file->off == block_size) {
+            /* Entering a block: littlefs walks the CTZ skip-list and positions the file */
+            lfs_ssize_t res = lfs_file_read(efs->fs, file, data + nread, MIN(size - nread, block_size));
+            if (res <= 0) {
+                return nread ? (lfs_ssize_t)nread : res;
+            }
+            nread += res;
+            continue;
+        }
+
+        size_t diff = MIN(size - nread, MIN(block_size - file->off, file->ctz.size - file->pos));
+        size_t part_off = (file->block * block_size) + file->off;
+        const uint8_t *src = NULL;
+        if (part_off + diff <= efs->partition->size
+#ifdef CONFIG_LITTLEFS_BLOCK_CACHE
+                /* Flash doesn't hold the block's latest contents yet */
+                && !esp_littlefs_block_cache_is_dirty(efs, file->block)
+#endif
+#ifdef CONFIG_LITTLEFS_OVERLAY
+                && !esp_littlefs_overlay_holds(efs, file->block)
+#endif
+        ) {
+            src = littlefs_esp_part_mmap(efs, part_off, &diff);
+        }
+        if (src == NULL) {
+            lfs_ssize_t res = lfs_file_read(efs->fs, file, data + nread, diff);
+            if (res < 0) {
+                return nread ? (lfs_ssize_t)nread : res;
+            }
+            nread += res;
+            continue;
+        }
+
+        memcpy(data + nread, src, diff);
+        file->pos += diff;
+        file->off += diff;
+        nread += diff;
+    }
+    return nread;
+}
+#endif
+
+static int littlefs_esp_part_read_raw(const struct lfs_config *c, uint64_t addr, void *buffer, size_t size) {
+    esp_littlefs_t * efs = c->context;
+    esp_err_t err = esp_partition_read(efs->partition, addr, buffer, size);
+    if (err) {
+        ESP_LOGE(ESP_LITTLEFS_TAG, "failed to read addr %08x, size %08x, err %d", (unsigned int) addr, (unsigned int) size, err);
+        return LFS_ERR_IO;
+    }
+    return 0;
+}
+
 int littlefs_esp_part_read(const struct lfs_config *c, lfs_block_t block,
                            lfs_off_t off, void *buffer, lfs_size_t size) {
-    esp_littlefs_t * efs = c->context;
     size_t part_off = (block * c->block_size) + off;
     
 #ifdef CONFIG_LITTLEFS_WDT_RESET
     esp_task_wdt_reset();
 #endif
     
-    esp_err_t err = esp_partition_read(efs->partition, part_off, buffer, size);
-    if (err) {
-        ESP_LOGE(ESP_LITTLEFS_TAG, "failed to read addr %08x, size %08x, err %d", (unsigned int) part_off, (unsigned int) size, err);
-        return LFS_ERR_IO;
-    }
-    return 0;
+#ifdef CONFIG_LITTLEFS_READAHEAD
+    esp_littlefs_t * efs = c->context;
+    return littlefs_readahead_read(c, part_off, buffer, size, efs->partition->size, littlefs_esp_part_read_raw);
+#else
+    return littlefs_esp_part_read_raw(c, part_off, buffer, size);
+#endif
 }
 
 int littlefs_esp_part_write(const struct lfs_config *c, lfs_block_t block,
@@ -57,6 +240,14 @@ int littlefs_esp_part_write(const struct lfs_config *c, lfs_block_t block,
     esp_task_wdt_reset();
 #endif
     
+#ifdef CONFIG_LITTLEFS_PREERASE
+    littlefs_preerase_note_prog(efs, block);
+#endif
+
+#ifdef CONFIG_LITTLEFS_READAHEAD
+    littlefs_readahead_invalidate(efs, part_off, size);
+#endif
+
     esp_err_t err = esp_partition_write(efs->partition, part_off, buffer, size);
     if (err) {
         ESP_LOGE(ESP_LITTLEFS_TAG, "failed to write addr %08x, size %08x, err %d", (unsigned int) part_off, (unsigned int) size, err);
@@ -65,19 +256,86 @@ int littlefs_esp_part_write(const struct lfs_config *c, lfs_block_t block,
     return 0;
 }
 
+#if CONFIG_LITTLEFS_PREERASE_COALESCE_SIZE
+/**
+ * @brief Find the aligned CONFIG_LITTLEFS_PREERASE_COALESCE_SIZE flash block around `block`,
+ *        if littlefs uses none of it besides `block`.
+ */
+static bool littlefs_esp_part_coalesce(esp_littlefs_t * efs, const struct lfs_config *c, lfs_block_t block,
+                                       lfs_block_t *first, lfs_size_t *count) {
+    const lfs_size_t n = CONFIG_LITTLEFS_PREERASE_COALESCE_SIZE / c->block_size;
+    if (n < 2 || CONFIG_LITTLEFS_PREERASE_COALESCE_SIZE % c->block_size || efs->partition->address % c->block_size) {
+        return false;
+    }
+
+    /* Alignment is on the flash address, not the partition offset */
+    const lfs_block_t phase = (efs->partition->address / c->block_size) % n;
+    const lfs_block_t skip = (block + phase) % n;
+    if (block < skip) {
+        return false;
+    }
+    *first = block - skip;
+    *count = n;
+    return littlefs_preerase_can_coalesce(efs, block, *first, *count);
+}
+#endif
+
 int littlefs_esp_part_erase(const struct lfs_config *c, lfs_block_t block) {
     esp_littlefs_t * efs = c->context;
     size_t part_off = block * c->block_size;
+    size_t size = c->block_size;
     
 #ifdef CONFIG_LITTLEFS_WDT_RESET
     esp_task_wdt_reset();
 #endif
     
-    esp_err_t err = esp_partition_erase_range(efs->partition, part_off, c->block_size);
+#ifdef CONFIG_LITTLEFS_PREERASE
+    if (littlefs_preerase_claim(efs, block)) {
+        return 0;
+    }
+#endif
+
+#ifdef CONFIG_LITTLEFS_ERASE_BLANK_CHECK
+    if (littlefs_esp_part_is_blank(efs, part_off, c->block_size)) {
+        efs->erase_skipped++;
+        return 0;
+    }
+#endif
+
+#if CONFIG_LITTLEFS_PREERASE_COALESCE_SIZE
+    /* Erase the free blocks around it along with it, in one flash block erase */
+    lfs_block_t first;
+    lfs_size_t count = 1;
+    if (littlefs_esp_part_coalesce(efs, c, block, &first, &count)) {
+        part_off = first * c->block_size;
+        size = count * c->block_size;
+    }
+#endif
+
+#ifdef CONFIG_LITTLEFS_READAHEAD
+    littlefs_readahead_invalidate(efs, part_off, size);
+#endif
+
+#ifdef CONFIG_LITTLEFS_FLASH_SIM
+    littlefs_flash_sim_note_erase(efs, efs->partition->address + part_off, size);
+#endif
+
+    esp_err_t err = esp_partition_erase_range(efs->partition, part_off, size);
     if (err) {
-        ESP_LOGE(ESP_LITTLEFS_TAG, "failed to erase addr %08x, size %08x, err %d", (unsigned int) part_off, (unsigned int) c->block_size, err);
+        ESP_LOGE(ESP_LITTLEFS_TAG, "failed to erase addr %08x, size %08x, err %d", (unsigned int) part_off, (unsigned int) size, err);
         return LFS_ERR_IO;
     }
+
+#ifdef CONFIG_LITTLEFS_WEAR_TRACKING
+    /* part_off and size cover every block the erase actually reached */
+    littlefs_wear_note_erase(efs, part_off / c->block_size, size / c->block_size);
+#endif
+
+#if CONFIG_LITTLEFS_PREERASE_COALESCE_SIZE
+    if (count > 1) {
+        littlefs_preerase_note_coalesced(efs, block, first, count);
+    }
+#endif
     return 0;
 
 }
@@ -0,0 +1,88 @@
+/**
+ * @file littlefs_flash_sim.c
+ * @brief NOR flash timing model for host (linux target) builds
+ *
+ * Stacked directly on top of the partition callbacks, it accumulates the time
+ * the operations would have taken on a real SPI NOR flash, and optionally waits
+ * for it. The model is deterministic, so two runs of the same workload report
+ * the same device time.
+ *
+ * Erases are charged by the partition erase callback where they reach the flash,
+ * so erases it skips (pre-erased or blank blocks) are free and coalesced ones
+ * cost a block erase.
+ */
+
+#include <unistd.h>
+#include <sys/param.h>
+#include "littlefs_api.h"
+
+#ifdef CONFIG_LITTLEFS_FLASH_SIM
+
+#define FLASH_SIM_PAGE_SIZE   256
+#define FLASH_SIM_SECTOR_SIZE 4096
+#define FLASH_SIM_BLOCK_SIZE  0x10000
+
+static void flash_sim_charge(esp_littlefs_t *efs, uint64_t ns)
+{
+    esp_littlefs_flash_sim_t *sim = &efs->flash_sim;
+
+    ns += sim->time_ns;
+    sim->time_us += ns / 1000;
+    sim->time_ns = ns % 1000;
+
+#ifdef CONFIG_LITTLEFS_FLASH_SIM_DELAY
+    usleep(ns / 1000);
+#endif
+}
+
+static int littlefs_flash_sim_read(const struct lfs_config *c, lfs_block_t block,
+                                   lfs_off_t off, void *buffer, lfs_size_t size)
+{
+    esp_littlefs_t *efs = c->context;
+    flash_sim_charge(efs, CONFIG_LITTLEFS_FLASH_SIM_READ_OP_NS +
+                          (uint64_t)size * CONFIG_LITTLEFS_FLASH_SIM_READ_NS_PER_BYTE);
+    return efs->flash_sim.backend_read(c, block, off, buffer, size);
+}
+
+static int littlefs_flash_sim_prog(const struct lfs_config *c, lfs_block_t block,
+                                   lfs_off_t off, const void *buffer, lfs_size_t size)
+{
+    esp_littlefs_t *efs = c->context;
+    /* Programming is done a page at a time; partial pages cost a full page */
+    const uint64_t start = (uint64_t)block * c->block_size + off;
+    const uint64_t pages = (start + size + FLASH_SIM_PAGE_SIZE - 1) / FLASH_SIM_PAGE_SIZE - start / FLASH_SIM_PAGE_SIZE;
+    flash_sim_charge(efs, pages * CONFIG_LITTLEFS_FLASH_SIM_PROG_PAGE_US * 1000);
+    return efs->flash_sim.backend_prog(c, block, off, buffer, size);
+}
+
+void littlefs_flash_sim_note_erase(esp_littlefs_t *efs, size_t addr, size_t size)
+{
+    uint64_t us = 0;
+
+    /* Like esp_flash_erase_region(): 64KB block erases where aligned, sector erases elsewhere */
+    while (size > 0) {
+        if (addr % FLASH_SIM_BLOCK_SIZE == 0 && size >= FLASH_SIM_BLOCK_SIZE) {
+            us += CONFIG_LITTLEFS_FLASH_SIM_BLOCK_ERASE_US;
+            addr += FLASH_SIM_BLOCK_SIZE;
+            size -= FLASH_SIM_BLOCK_SIZE;
+        } else {
+            us += CONFIG_LITTLEFS_FLASH_SIM_ERASE_US;
+            addr += FLASH_SIM_SECTOR_SIZE;
+            size -= MIN(size, FLASH_SIM_SECTOR_SIZE);
+        }
+    }
+    flash_sim_charge(efs, us * 1000);
+}
+
+void esp_littlefs_flash_sim_init(esp_littlefs_t *efs)
+{
+    esp_littlefs_flash_sim_t *sim = &efs->flash_sim;
+
+    sim->backend_read  = efs->cfg.read;
+    sim->backend_prog  = efs->cfg.prog;
+
+    efs->cfg.read  = littlefs_flash_sim_read;
+    efs->cfg.prog  = littlefs_flash_sim_prog;
+}
+
+#endif // CONFIG_LITTLEFS_FLASH_SIM
@@ -0,0 +1,97 @@
+/**
+ * @file littlefs_io_stats.c
+ * @brief Block device I/O counters stacked on top of a backend's lfs_config callbacks
+ *
+ * The callbacks are wrapped once per mount, below the block cache (if any), so
+ * the counters reflect what actually reaches the partition/SD card/blockdev HAL.
+ * The pre-erase task calls the HAL directly and is counted through
+ * littlefs_io_stats_erase_with(). Everything runs with efs->lock held, so plain
+ * increments are enough.
+ */
+
+#include "esp_timer.h"
+#include "littlefs_api.h"
+
+#ifdef CONFIG_LITTLEFS_IO_STATS
+
+static void io_stats_record(esp_littlefs_io_op_stats_t *op, int64_t t_start, size_t bytes, int res)
+{
+    uint32_t us = (uint32_t)(esp_timer_get_time() - t_start);
+    size_t bucket = 0;
+
+    for (uint32_t v = us >> 4; v && bucket < ESP_LITTLEFS_IO_STATS_HIST_BUCKETS - 1; v >>= 2) {
+        bucket++;
+    }
+
+    op->count++;
+    op->bytes += bytes;
+    op->total_us += us;
+    if (us > op->max_us) {
+        op->max_us = us;
+    }
+    if (res < 0) {
+        op->errors++;
+    }
+    op->hist[bucket]++;
+}
+
+static int littlefs_io_stats_read(const struct lfs_config *c, lfs_block_t block,
+                                  lfs_off_t off, void *buffer, lfs_size_t size)
+{
+    esp_littlefs_t *efs = c->context;
+    int64_t t_start = esp_timer_get_time();
+    int res = efs->io_stats.backend_read(c, block, off, buffer, size);
+    io_stats_record(&efs->io_stats.stats.read, t_start, size, res);
+    return res;
+}
+
+static int littlefs_io_stats_prog(const struct lfs_config *c, lfs_block_t block,
+                                  lfs_off_t off, const void *buffer, lfs_size_t size)
+{
+    esp_littlefs_t *efs = c->context;
+    int64_t t_start = esp_timer_get_time();
+    int res = efs->io_stats.backend_prog(c, block, off, buffer, size);
+    io_stats_record(&efs->io_stats.stats.prog, t_start, size, res);
+    return res;
+}
+
+int littlefs_io_stats_erase_with(esp_littlefs_t *efs, int (*erase)(const struct lfs_config *c, lfs_block_t block),
+                                 lfs_block_t block)
+{
+    int64_t t_start = esp_timer_get_time();
+    int res = erase(&efs->cfg, block);
+    io_stats_record(&efs->io_stats.stats.erase, t_start, efs->cfg.block_size, res);
+    return res;
+}
+
+static int littlefs_io_stats_erase(const struct lfs_config *c, lfs_block_t block)
+{
+    esp_littlefs_t *efs = c->context;
+    return littlefs_io_stats_erase_with(efs, efs->io_stats.backend_erase, block);
+}
+
+static int littlefs_io_stats_sync(const struct lfs_config *c)
+{
+    esp_littlefs_t *efs = c->context;
+    int64_t t_start = esp_timer_get_time();
+    int res = efs->io_stats.backend_sync(c);
+    io_stats_record(&efs->io_stats.stats.sync, t_start, 0, res);
+    return res;
+}
+
+void esp_littlefs_io_stats_init(esp_littlefs_t *efs)
+{
+    esp_littlefs_io_stats_layer_t *io = &efs->io_stats;
+
+    io->backend_read  = efs->cfg.read;
+    io->backend_prog  = efs->cfg.prog;
+    io->backend_erase = efs->cfg.erase;
+    io->backend_sync  = efs->cfg.sync;
+
+    efs->cfg.read  = littlefs_io_stats_read;
+    efs->cfg.prog  = littlefs_io_stats_prog;
+    efs->cfg.erase = littlefs_io_stats_erase;
+    efs->cfg.sync  = littlefs_io_stats_sync;
+}
+
+#endif // CONFIG_LITTLEFS_IO_STATS
@@ -0,0 +1,602 @@
+/**
+ * @file littlefs_overlay.c
+ * @brief RAM write overlay with periodic checkpoints to a flash partition
+ *
+ * Installs itself in place of the read/prog/erase/sync callbacks of an
+ * initialized esp_littlefs_t. Progs and erases land in whole-block RAM slots;
+ * the flash is left untouched until a checkpoint, which is taken periodically
+ * by a background task, on esp_littlefs_checkpoint(), or when all slots are in use.
+ *
+ * Writing the slots back one by one wouldn't be atomic: littlefs only survives
+ * power loss if its writes reach the flash in the order it issued them, and the
+ * overlay deliberately coalesces them. So a checkpoint is first written as a
+ * redo log to a journal area reserved at the end of the partition, then applied
+ * to the home blocks. The log becomes valid when its header is programmed, and
+ * is marked applied once every home block is written. A log that is valid but
+ * not applied is replayed at mount; replaying is idempotent.
+ *
+ * Journal layout: a checkpoint occupies consecutive journal blocks (wrapping
+ * around), starting with a header followed by records of
+ * {block, flags, off, len} and `len` bytes of block data.
+ */
+
+#include <string.h>
+#include <sys/param.h>
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "littlefs_api.h"
+
+#ifdef CONFIG_LITTLEFS_OVERLAY
+
+#define OVERLAY_MAGIC        0x4a53464c /* "LFSJ" */
+#define OVERLAY_REC_ERASED   0x1
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;                             /* Checkpoint sequence number */
+    uint32_t len;                             /* Bytes of records following the header */
+    uint32_t count;                           /* Number of records */
+    uint32_t payload_crc;                     /* CRC of the records */
+    uint32_t crc;                             /* CRC of the fields above */
+    uint32_t applied;                         /* 0xFFFFFFFF until the home blocks are written; not covered by crc */
+    uint32_t reserved;
+} overlay_header_t;
+
+typedef struct {
+    uint32_t block;
+    uint32_t flags;
+    uint32_t off;
+    uint32_t len;
+} overlay_record_t;
+
+/* Sequential access to the byte stream of a checkpoint in the journal */
+typedef struct {
+    esp_littlefs_t *efs;
+    lfs_size_t      start;                    /* Journal block the checkpoint starts at */
+    size_t          pos;                      /* Stream offset, including the header */
+    uint32_t        crc;                      /* CRC of the records written/read so far */
+} overlay_stream_t;
+
+static inline lfs_block_t stream_block(const overlay_stream_t *s, size_t pos)
+{
+    const esp_littlefs_overlay_t *ov = &s->efs->overlay;
+    return ov->journal + (s->start + pos / s->efs->cfg.block_size) % ESP_LITTLEFS_OVERLAY_JOURNAL_BLOCKS;
+}
+
+static inline size_t align_up(size_t n, size_t align)
+{
+    return (n + align - 1) / align * align;
+}
+
+static esp_littlefs_overlay_slot_t *overlay_lookup(esp_littlefs_overlay_t *ov, lfs_block_t block)
+{
+    for (size_t i = 0; i < CONFIG_LITTLEFS_OVERLAY_BLOCKS; i++) {
+        esp_littlefs_overlay_slot_t *slot = &ov->slots[i];
+        if (slot->valid && slot->block == block) {
+            return slot;
+        }
+    }
+    return NULL;
+}
+
+/* Program the staged part of the current journal block */
+static int stream_flush(overlay_stream_t *s)
+{
+    esp_littlefs_t *efs = s->efs;
+    esp_littlefs_overlay_t *ov = &efs->overlay;
+    const size_t fill = s->pos % efs->cfg.block_size;
+
+    if (fill == 0) {
+        return LFS_ERR_OK;
+    }
+    return ov->backend_prog(&efs->cfg, stream_block(s, s->pos - 1), 0, ov->buf,
+                            align_up(fill, efs->cfg.prog_size));
+}
+
+static int stream_write(overlay_stream_t *s, const void *data, size_t size)
+{
+    esp_littlefs_t *efs = s->efs;
+    esp_littlefs_overlay_t *ov = &efs->overlay;
+    const size_t block_size = efs->cfg.block_size;
+    const uint8_t *src = data;
+
+    s->crc = lfs_crc(s->crc, data, size);
+    while (size) {
+        const size_t fill = s->pos % block_size;
+        if (fill == 0) {
+            /* Starting a new journal block */
+            int res = ov->backend_erase(&efs->cfg, stream_block(s, s->pos));
+            if (res != LFS_ERR_OK) {
+                return res;
+            }
+            memset(ov->buf, 0xFF, block_size);
+        }
+        const size_t n = MIN(size, block_size - fill);
+        memcpy(&ov->buf[fill], src, n);
+        s->pos += n;
+        src += n;
+        size -= n;
+        if (s->pos % block_size == 0) {
+            int res = ov->backend_prog(&efs->cfg, stream_block(s, s->pos - 1), 0, ov->buf, block_size);
+            if (res != LFS_ERR_OK) {
+                return res;
+            }
+        }
+    }
+    return LFS_ERR_OK;
+}
+
+static int stream_read(overlay_stream_t *s, void *data, size_t size)
+{
+    esp_littlefs_t *efs = s->efs;
+    const size_t block_size = efs->cfg.block_size;
+    uint8_t *dst = data;
+
+    while (size) {
+        const size_t off = s->pos % block_size;
+        const size_t n = MIN(size, block_size - off);
+        int res = efs->overlay.backend_read(&efs->cfg, stream_block(s, s->pos), off, dst, n);
+        if (res != LFS_ERR_OK) {
+            return res;
+        }
+        s->crc = lfs_crc(s->crc, dst, n);
+        s->pos += n;
+        dst += n;
+        size -= n;
+    }
+    return LFS_ERR_OK;
+}
+
+static uint32_t header_crc(const overlay_header_t *hdr)
+{
+    return lfs_crc(0xffffffff, hdr, offsetof(overlay_header_t, crc));
+}
+
+static int overlay_mark_applied(esp_littlefs_t *efs, lfs_size_t start)
+{
+    esp_littlefs_overlay_t *ov = &efs->overlay;
+    const uint32_t applied = 0;
+    return ov->backend_prog(&efs->cfg, ov->journal + start, offsetof(overlay_header_t, applied),
+                            &applied, sizeof(applied));
+}
+
+/* Write the slots to the journal and then to their home blocks. Must be called with efs->lock held. */
+static int overlay_commit(esp_littlefs_t *efs)
+{
+    esp_littlefs_overlay_t *ov = &efs->overlay;
+    overlay_header_t hdr = {
+        .magic = OVERLAY_MAGIC,
+        .seq = ov->seq,
+    };
+    overlay_stream_t s = {
+        .efs = efs,
+        .start = ov->journal_next,
+        .pos = 0,
+    };
+    int res;
+
+    if (ov->used == 0) {
+        return LFS_ERR_OK;
+    }
+
+    /* Records go after the header, which is programmed last */
+    memset(ov->buf, 0xFF, efs->cfg.block_size);
+    res = ov->backend_erase(&efs->cfg, stream_block(&s, 0));
+    if (res != LFS_ERR_OK) {
+        return res;
+    }
+    s.pos = sizeof(hdr);
+    s.crc = 0xffffffff;
+
+    for (size_t i = 0; i < CONFIG_LITTLEFS_OVERLAY_BLOCKS; i++) {
+        const esp_littlefs_overlay_slot_t *slot = &ov->slots[i];
+        if (!slot->valid) {
+            continue;
+        }
+        const overlay_record_t rec = {
+            .block = slot->block,
+            .flags = slot->erased ? OVERLAY_REC_ERASED : 0,
+            .off = slot->dirty_start,
+            .len = slot->dirty_end - slot->dirty_start,
+        };
+        res = stream_write(&s, &rec, sizeof(rec));
+        if (res == LFS_ERR_OK) {
+            res = stream_write(&s, &slot->data[rec.off], rec.len);
+        }
+        if (res != LFS_ERR_OK) {
+            return res;
+        }
+        hdr.count++;
+    }
+    res = stream_flush(&s);
+    if (res != LFS_ERR_OK) {
+        return res;
+    }
+
+    hdr.len = s.pos - sizeof(hdr);
+    hdr.payload_crc = s.crc;
+    hdr.crc = header_crc(&hdr);
+    hdr.applied = 0xffffffff;
+    hdr.reserved = 0xffffffff;
+    res = ov->backend_prog(&efs->cfg, ov->journal + s.start, 0, &hdr, sizeof(hdr));
+    if (res != LFS_ERR_OK) {
+        return res;
+    }
+    /* The checkpoint is durable from here on */
+    ov->seq++;
+    ov->journal_next = (s.start + (s.pos + efs->cfg.block_size - 1) / efs->cfg.block_size) %
+                       ESP_LITTLEFS_OVERLAY_JOURNAL_BLOCKS;
+
+    for (size_t i = 0; i < CONFIG_LITTLEFS_OVERLAY_BLOCKS; i++) {
+        esp_littlefs_overlay_slot_t *slot = &ov->slots[i];
+        if (!slot->valid) {
+            continue;
+        }
+        if (slot->erased) {
+            res = ov->backend_erase(&efs->cfg, slot->block);
+            if (res != LFS_ERR_OK) {
+                return res;
+            }
+        }
+        if (slot->dirty_end > slot->dirty_start) {
+            res = ov->backend_prog(&efs->cfg, slot->block, slot->dirty_start,
+                                   &slot->data[slot->dirty_start], slot->dirty_end - slot->dirty_start);
+            if (res != LFS_ERR_OK) {
+                return res;
+            }
+        }
+        slot->valid = false;
+        ov->used--;
+    }
+    ov->checkpoints++;
+
+    return overlay_mark_applied(efs, s.start);
+}
+
+/* Apply a checkpoint found in the journal that didn't reach its home blocks */
+static int overlay_replay(esp_littlefs_t *efs, lfs_size_t start, const overlay_header_t *hdr)
+{
+    esp_littlefs_overlay_t *ov = &efs->overlay;
+    overlay_stream_t s = {
+        .efs = efs,
+        .start = start,
+        .pos = sizeof(*hdr),
+        .crc = 0xffffffff,
+    };
+    overlay_record_t rec;
+    int res;
+
+    /* Verify the whole log before touching any home block */
+    while (s.pos < sizeof(*hdr) + hdr->len) {
+        res = stream_read(&s, &rec, sizeof(rec));
+        if (res != LFS_ERR_OK) {
+            return res;
+        }
+        if (rec.off + rec.len > efs->cfg.block_size) {
+            return LFS_ERR_CORRUPT;
+        }
+        res = stream_read(&s, ov->buf, rec.len);
+        if (res != LFS_ERR_OK) {
+            return res;
+        }
+    }
+    if (s.crc != hdr->payload_crc) {
+        return LFS_ERR_CORRUPT;
+    }
+
+    s.pos = sizeof(*hdr);
+    for (uint32_t i = 0; i < hdr->count; i++) {
+        res = stream_read(&s, &rec, sizeof(rec));
+        if (res == LFS_ERR_OK) {
+            res = stream_read(&s, ov->buf, rec.len);
+        }
+        if (res == LFS_ERR_OK && (rec.flags & OVERLAY_REC_ERASED)) {
+            res = ov->backend_erase(&efs->cfg, rec.block);
+        }
+        if (res == LFS_ERR_OK && rec.len) {
+            res = ov->backend_prog(&efs->cfg, rec.block, rec.off, ov->buf, rec.len);
+        }
+        if (res != LFS_ERR_OK) {
+            return res;
+        }
+    }
+
+    return overlay_mark_applied(efs, start);
+}
+
+/* Find the newest checkpoint in the journal, and finish applying it if needed */
+static int overlay_recover(esp_littlefs_t *efs)
+{
+    esp_littlefs_overlay_t *ov = &efs->overlay;
+    overlay_header_t hdr, newest = { 0 };
+    lfs_size_t newest_start = 0;
+    bool found = false;
+
+    for (lfs_size_t i = 0; i < ESP_LITTLEFS_OVERLAY_JOURNAL_BLOCKS; i++) {
+        int res = ov->backend_read(&efs->cfg, ov->journal + i, 0, &hdr, sizeof(hdr));
+        if (res != LFS_ERR_OK) {
+            return res;
+        }
+        if (hdr.magic != OVERLAY_MAGIC || hdr.crc != header_crc(&hdr) ||
+                hdr.len > (ESP_LITTLEFS_OVERLAY_JOURNAL_BLOCKS * efs->cfg.block_size) - sizeof(hdr)) {
+            continue;
+        }
+        if (!found || (int32_t)(hdr.seq - newest.seq) > 0) {
+            newest = hdr;
+            newest_start = i;
+            found = true;
+        }
+    }
+
+    if (!found) {
+        return LFS_ERR_OK;
+    }
+
+    ov->seq = newest.seq + 1;
+    ov->journal_next = (newest_start + (sizeof(newest) + newest.len + efs->cfg.block_size - 1) / efs->cfg.block_size) %
+                       ESP_LITTLEFS_OVERLAY_JOURNAL_BLOCKS;
+    if (newest.applied == 0) {
+        return LFS_ERR_OK;
+    }
+
+    ESP_LOGW(ESP_LITTLEFS_TAG, "Replaying interrupted checkpoint %" PRIu32, newest.seq);
+    return overlay_replay(efs, newest_start, &newest);
+}
+
+/* Get the slot for `block`, taking a checkpoint first if the overlay is full */
+static int overlay_get(const struct lfs_config *c, lfs_block_t block, bool fill, esp_littlefs_overlay_slot_t **out)
+{
+    esp_littlefs_t *efs = c->context;
+    esp_littlefs_overlay_t *ov = &efs->overlay;
+    esp_littlefs_overlay_slot_t *slot = overlay_lookup(ov, block);
+
+    if (slot == NULL) {
+        if (ov->used == CONFIG_LITTLEFS_OVERLAY_BLOCKS) {
+            int res = overlay_commit(efs);
+            if (res != LFS_ERR_OK) {
+                return res;
+            }
+        }
+        for (size_t i = 0; i < CONFIG_LITTLEFS_OVERLAY_BLOCKS; i++) {
+            if (!ov->slots[i].valid) {
+                slot = &ov->slots[i];
+                break;
+            }
+        }
+        if (fill) {
+            int res = ov->backend_read(c, block, 0, slot->data, c->block_size);
+            if (res != LFS_ERR_OK) {
+                return res;
+            }
+        }
+        slot->block = block;
+        slot->valid = true;
+        slot->erased = false;
+        slot->dirty_start = slot->dirty_end = 0;
+        ov->used++;
+    }
+
+    *out = slot;
+    return LFS_ERR_OK;
+}
+
+static int littlefs_overlay_read(const struct lfs_config *c, lfs_block_t block,
+                                 lfs_off_t off, void *buffer, lfs_size_t size)
+{
+    esp_littlefs_t *efs = c->context;
+    esp_littlefs_overlay_slot_t *slot = overlay_lookup(&efs->overlay, block);
+
+    if (slot) {
+        memcpy(buffer, &slot->data[off], size);
+        return LFS_ERR_OK;
+    }
+    return efs->overlay.backend_read(c, block, off, buffer, size);
+}
+
+static int littlefs_overlay_prog(const struct lfs_config *c, lfs_block_t block,
+                                 lfs_off_t off, const void *buffer, lfs_size_t size)
+{
+    esp_littlefs_overlay_slot_t *slot;
+
+    /* Appending to a block erased before the last checkpoint; the rest of it is on flash */
+    int res = overlay_get(c, block, true, &slot);
+    if (res != LFS_ERR_OK) {
+        return res;
+    }
+
+    memcpy(&slot->data[off], buffer, size);
+    if (slot->dirty_end > slot->dirty_start) {
+        /* Bytes in between hold what's already on flash, so reprogramming them is harmless */
+        slot->dirty_start = MIN(slot->dirty_start, off);
+        slot->dirty_end = MAX(slot->dirty_end, off + size);
+    } else {
+        slot->dirty_start = off;
+        slot->dirty_end = off + size;
+    }
+    return LFS_ERR_OK;
+}
+
+static int littlefs_overlay_erase(const struct lfs_config *c, lfs_block_t block)
+{
+    esp_littlefs_overlay_slot_t *slot;
+
+    int res = overlay_get(c, block, false, &slot);
+    if (res != LFS_ERR_OK) {
+        return res;
+    }
+
+    memset(slot->data, 0xFF, c->block_size);
+    slot->dirty_start = slot->dirty_end = 0;
+    slot->erased = true;
+    return LFS_ERR_OK;
+}
+
+static int littlefs_overlay_sync(const struct lfs_config *c)
+{
+    /* Durability is deferred to the next checkpoint */
+    (void)c;
+    return LFS_ERR_OK;
+}
+
+static void overlay_task(void *arg)
+{
+    esp_littlefs_t *efs = arg;
+    esp_littlefs_overlay_t *ov = &efs->overlay;
+
+    while (!ov->stop) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(ov->interval_ms));
+        if (ov->stop) {
+            break;
+        }
+        if (esp_littlefs_overlay_checkpoint(efs) != LFS_ERR_OK) {
+            ESP_LOGE(ESP_LITTLEFS_TAG, "periodic checkpoint failed");
+        }
+    }
+
+    xSemaphoreGive(ov->done);
+    vTaskDelete(NULL);
+}
+
+esp_err_t esp_littlefs_overlay_init(esp_littlefs_t *efs)
+{
+    esp_littlefs_overlay_t *ov = &efs->overlay;
+    const size_t part_blocks = efs->partition->size / efs->cfg.block_size;
+
+    /* The journal header is programmed over bytes that were already programmed,
+     * which only works on plain NOR flash, not through flash encryption */
+    if (efs->partition->encrypted) {
+        ESP_LOGE(ESP_LITTLEFS_TAG, "write overlay is not supported on encrypted partitions");
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    if (part_blocks < ESP_LITTLEFS_OVERLAY_JOURNAL_BLOCKS + 2) {
+        ESP_LOGE(ESP_LITTLEFS_TAG, "partition is too small for a %d block overlay journal",
+                 ESP_LITTLEFS_OVERLAY_JOURNAL_BLOCKS);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    for (size_t i = 0; i < CONFIG_LITTLEFS_OVERLAY_BLOCKS; i++) {
+        ov->slots[i].data = heap_caps_malloc_prefer(efs->cfg.block_size, 2,
+                                                    MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT,
+                                                    MALLOC_CAP_DEFAULT);
+        if (ov->slots[i].data == NULL) {
+            ESP_LOGE(ESP_LITTLEFS_TAG, "overlay slot could not be malloced");
+            esp_littlefs_overlay_deinit(efs);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    ov->buf = esp_littlefs_calloc(1, efs->cfg.block_size);
+    if (ov->buf == NULL) {
+        ESP_LOGE(ESP_LITTLEFS_TAG, "overlay journal buffer could not be malloced");
+        esp_littlefs_overlay_deinit(efs);
+        return ESP_ERR_NO_MEM;
+    }
+
+    /* The journal lives past the end of the filesystem */
+    ov->journal = part_blocks - ESP_LITTLEFS_OVERLAY_JOURNAL_BLOCKS;
+    efs->cfg.block_count = ov->journal;
+
+    ov->backend_read  = efs->cfg.read;
+    ov->backend_prog  = efs->cfg.prog;
+    ov->backend_erase = efs->cfg.erase;
+    ov->backend_sync  = efs->cfg.sync;
+
+    if (overlay_recover(efs) != LFS_ERR_OK) {
+        ESP_LOGE(ESP_LITTLEFS_TAG, "failed to recover the overlay journal");
+        esp_littlefs_overlay_deinit(efs);
+        return ESP_FAIL;
+    }
+
+    efs->cfg.read  = littlefs_overlay_read;
+    efs->cfg.prog  = littlefs_overlay_prog;
+    efs->cfg.erase = littlefs_overlay_erase;
+    efs->cfg.sync  = littlefs_overlay_sync;
+    return ESP_OK;
+}
+
+esp_err_t esp_littlefs_overlay_start(esp_littlefs_t *efs)
+{
+    esp_littlefs_overlay_t *ov = &efs->overlay;
+
+    ov->done = xSemaphoreCreateBinary();
+    if (ov->done == NULL) {
+        ESP_LOGE(ESP_LITTLEFS_TAG, "overlay semaphore could not be created");
+        return ESP_ERR_NO_MEM;
+    }
+    if (xTaskCreate(overlay_task, "littlefs_ckpt", CONFIG_LITTLEFS_OVERLAY_TASK_STACK,
+                    efs, CONFIG_LITTLEFS_OVERLAY_TASK_PRIORITY, &ov->task) != pdPASS) {
+        ESP_LOGE(ESP_LITTLEFS_TAG, "checkpoint task could not be created");
+        ov->task = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void esp_littlefs_overlay_stop(esp_littlefs_t *efs)
+{
+    esp_littlefs_overlay_t *ov = &efs->overlay;
+
+    if (ov->task) {
+        ov->stop = true;
+        xTaskNotifyGive(ov->task);
+        xSemaphoreTake(ov->done, portMAX_DELAY);
+        ov->task = NULL;
+    }
+    if (ov->done) {
+        vSemaphoreDelete(ov->done);
+        ov->done = NULL;
+    }
+    ov->stop = false;
+}
+
+int esp_littlefs_overlay_checkpoint(esp_littlefs_t *efs)
+{
+    int res = LFS_ERR_OK;
+
+    if (efs->overlay.journal == 0) {
+        return LFS_ERR_OK;
+    }
+
+    xSemaphoreTakeRecursive(efs->lock, portMAX_DELAY);
+    /* Pull in anything a cache layer on top is still holding */
+    if (efs->cache_size > 0) {
+        res = efs->cfg.sync(&efs->cfg);
+    }
+    if (res == LFS_ERR_OK) {
+        res = overlay_commit(efs);
+    }
+    xSemaphoreGiveRecursive(efs->lock);
+    return res;
+}
+
+void esp_littlefs_overlay_deinit(esp_littlefs_t *efs)
+{
+    esp_littlefs_overlay_t *ov = &efs->overlay;
+
+    esp_littlefs_overlay_stop(efs);
+    if (ov->backend_read) {
+        if (overlay_commit(efs) != LFS_ERR_OK) {
+            ESP_LOGE(ESP_LITTLEFS_TAG, "final checkpoint failed, the last changes are lost");
+        }
+        efs->cfg.read  = ov->backend_read;
+        efs->cfg.prog  = ov->backend_prog;
+        efs->cfg.erase = ov->backend_erase;
+        efs->cfg.sync  = ov->backend_sync;
+    }
+
+    for (size_t i = 0; i < CONFIG_LITTLEFS_OVERLAY_BLOCKS; i++) {
+        free(ov->slots[i].data);
+    }
+    free(ov->buf);
+    memset(ov, 0, sizeof(*ov));
+}
+
+bool esp_littlefs_overlay_holds(esp_littlefs_t *efs, lfs_block_t block)
+{
+    return overlay_lookup(&efs->overlay, block) != NULL;
+}
+
+#endif // CONFIG_LITTLEFS_OVERLAY
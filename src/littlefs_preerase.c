@@ -0,0 +1,259 @@
+/**
+ * @file littlefs_preerase.c
+ * @brief Background task keeping a pool of free blocks erased ahead of time
+ *
+ * While the filesystem is idle, a low priority task takes the filesystem lock,
+ * works out which blocks are free (lfs_fs_traverse) and erases a few of them.
+ * Pre-erased blocks are tracked in a bitmap; when littlefs later allocates one
+ * of them, the HAL erase callback becomes a no-op.
+ *
+ * The free-block snapshot is only trusted while no prog/erase went through the
+ * HAL since it was taken; every change to littlefs's allocation state does.
+ * Blocks littlefs programs or erases are also marked used right away, so the
+ * snapshot never reports a block as free while littlefs is using it. With
+ * CONFIG_LITTLEFS_PREERASE_COALESCE_SIZE, the HAL relies on that to erase whole
+ * flash blocks when littlefs erases a block in the middle of free space.
+ */
+
+#include <string.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "littlefs_api.h"
+
+#ifdef CONFIG_LITTLEFS_PREERASE
+
+#define BITMAP_WORDS(n) (((n) + 31) / 32)
+
+static inline bool bit_get(const uint32_t *map, lfs_block_t i)
+{
+    return map[i / 32] & (1UL << (i % 32));
+}
+
+static inline void bit_set(uint32_t *map, lfs_block_t i)
+{
+    map[i / 32] |= (1UL << (i % 32));
+}
+
+static inline void bit_clear(uint32_t *map, lfs_block_t i)
+{
+    map[i / 32] &= ~(1UL << (i % 32));
+}
+
+static int preerase_mark_used(void *data, lfs_block_t block)
+{
+    esp_littlefs_preerase_t *pe = data;
+    if (block < pe->block_count) {
+        bit_set(pe->used, block);
+    }
+    return 0;
+}
+
+bool littlefs_preerase_claim(esp_littlefs_t *efs, lfs_block_t block)
+{
+    esp_littlefs_preerase_t *pe = &efs->preerase;
+
+    pe->changed = true;
+    pe->hint = block + 1;
+    if (pe->erased == NULL || block >= pe->block_count) {
+        return false;
+    }
+    bit_set(pe->used, block);
+    if (!bit_get(pe->erased, block)) {
+        return false;
+    }
+    bit_clear(pe->erased, block);
+    pe->pool--;
+    return true;
+}
+
+void littlefs_preerase_note_prog(esp_littlefs_t *efs, lfs_block_t block)
+{
+    esp_littlefs_preerase_t *pe = &efs->preerase;
+
+    pe->changed = true;
+    if (pe->erased == NULL || block >= pe->block_count) {
+        return;
+    }
+    bit_set(pe->used, block);
+    if (bit_get(pe->erased, block)) {
+        bit_clear(pe->erased, block);
+        pe->pool--;
+    }
+}
+
+#if CONFIG_LITTLEFS_PREERASE_COALESCE_SIZE
+bool littlefs_preerase_can_coalesce(esp_littlefs_t *efs, lfs_block_t block, lfs_block_t first, lfs_size_t count)
+{
+    esp_littlefs_preerase_t *pe = &efs->preerase;
+
+    if (pe->erased == NULL || !pe->traversed || first + count > pe->block_count) {
+        return false;
+    }
+    for (lfs_block_t i = first; i < first + count; i++) {
+        if (i != block && (bit_get(pe->used, i) || bit_get(pe->erased, i))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void littlefs_preerase_note_coalesced(esp_littlefs_t *efs, lfs_block_t block, lfs_block_t first, lfs_size_t count)
+{
+    esp_littlefs_preerase_t *pe = &efs->preerase;
+
+    for (lfs_block_t i = first; i < first + count; i++) {
+        if (i != block) {
+            bit_set(pe->erased, i);
+            pe->pool++;
+        }
+    }
+}
+#endif
+
+/* Snapshot the blocks in use. Must be called with efs->lock held. */
+static int preerase_traverse(esp_littlefs_t *efs)
+{
+    esp_littlefs_preerase_t *pe = &efs->preerase;
+
+    memset(pe->used, 0, BITMAP_WORDS(pe->block_count) * sizeof(uint32_t));
+    int res = lfs_fs_traverse(efs->fs, preerase_mark_used, pe);
+    if (res < 0) {
+        /* Leave nothing looking free */
+        memset(pe->used, 0xFF, BITMAP_WORDS(pe->block_count) * sizeof(uint32_t));
+        return res;
+    }
+    pe->changed = false;
+    pe->traversed = true;
+    return LFS_ERR_OK;
+}
+
+/* Erase one free block. Must be called with efs->lock held. */
+static void preerase_step(esp_littlefs_t *efs)
+{
+    esp_littlefs_preerase_t *pe = &efs->preerase;
+
+    if (efs->cache_size == 0 || efs->fs->block_count != pe->block_count) {
+        return; /* Not mounted, or mid-format */
+    }
+
+    if (pe->changed) {
+        /* Write back anything a cache layer is still holding, so no stale write
+         * can land on a block after it has been pre-erased. */
+        if (efs->cfg.sync(&efs->cfg) != LFS_ERR_OK) {
+            return;
+        }
+        if (preerase_traverse(efs) != LFS_ERR_OK) {
+            return;
+        }
+    }
+
+    /* littlefs allocates blocks in ascending order from where it last left off,
+     * so erase the free blocks right after its most recent allocation first. */
+    for (lfs_size_t n = 0; n < pe->block_count; n++) {
+        lfs_block_t block = (pe->hint + n) % pe->block_count;
+        if (bit_get(pe->used, block) || bit_get(pe->erased, block)) {
+            continue;
+        }
+
+        const lfs_block_t hint = pe->hint;
+#ifdef CONFIG_LITTLEFS_IO_STATS
+        int res = littlefs_io_stats_erase_with(efs, pe->erase, block);
+#else
+        int res = pe->erase(&efs->cfg, block);
+#endif
+        if (res == LFS_ERR_OK) {
+            bit_set(pe->erased, block);
+            pe->pool++;
+        }
+        /* Our own erase neither changes what's free nor where littlefs allocates next */
+        bit_clear(pe->used, block);
+        pe->changed = false;
+        pe->hint = hint;
+        return;
+    }
+}
+
+static void preerase_task(void *arg)
+{
+    esp_littlefs_t *efs = arg;
+    esp_littlefs_preerase_t *pe = &efs->preerase;
+
+    while (!pe->stop) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CONFIG_LITTLEFS_PREERASE_INTERVAL_MS));
+        if (pe->stop) {
+            break;
+        }
+
+        /* Only work while nobody else is using the filesystem */
+        while (!pe->stop && pe->pool < CONFIG_LITTLEFS_PREERASE_POOL_SIZE &&
+                xSemaphoreTakeRecursive(efs->lock, 0) == pdTRUE) {
+            lfs_size_t pool = pe->pool;
+            preerase_step(efs);
+            xSemaphoreGiveRecursive(efs->lock);
+            if (pe->pool == pool) {
+                break; /* No free block left to erase */
+            }
+            /* Give waiting writers a chance to grab the lock between erases */
+            taskYIELD();
+        }
+    }
+
+    xSemaphoreGive(pe->done);
+    vTaskDelete(NULL);
+}
+
+esp_err_t esp_littlefs_preerase_start(esp_littlefs_t *efs, int (*erase)(const struct lfs_config *c, lfs_block_t block))
+{
+    esp_littlefs_preerase_t *pe = &efs->preerase;
+    const size_t map_size = BITMAP_WORDS(efs->fs->block_count) * sizeof(uint32_t);
+
+    pe->block_count = efs->fs->block_count;
+    pe->erase = erase;
+    pe->changed = true;
+    pe->erased = esp_littlefs_calloc(1, map_size);
+    pe->used = esp_littlefs_calloc(1, map_size);
+    pe->done = xSemaphoreCreateBinary();
+    if (pe->erased == NULL || pe->used == NULL || pe->done == NULL) {
+        ESP_LOGE(ESP_LITTLEFS_TAG, "pre-erase pool could not be malloced");
+        esp_littlefs_preerase_stop(efs);
+        return ESP_ERR_NO_MEM;
+    }
+
+#if CONFIG_LITTLEFS_PREERASE_COALESCE_SIZE
+    /* Let the first bulk write coalesce erases without waiting for the task */
+    xSemaphoreTakeRecursive(efs->lock, portMAX_DELAY);
+    preerase_traverse(efs);
+    xSemaphoreGiveRecursive(efs->lock);
+#endif
+
+    if (xTaskCreate(preerase_task, "littlefs_preerase", CONFIG_LITTLEFS_PREERASE_TASK_STACK,
+                    efs, CONFIG_LITTLEFS_PREERASE_TASK_PRIORITY, &pe->task) != pdPASS) {
+        ESP_LOGE(ESP_LITTLEFS_TAG, "pre-erase task could not be created");
+        pe->task = NULL;
+        esp_littlefs_preerase_stop(efs);
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void esp_littlefs_preerase_stop(esp_littlefs_t *efs)
+{
+    esp_littlefs_preerase_t *pe = &efs->preerase;
+
+    if (pe->task) {
+        pe->stop = true;
+        xTaskNotifyGive(pe->task);
+        xSemaphoreTake(pe->done, portMAX_DELAY);
+        pe->task = NULL;
+    }
+    if (pe->done) {
+        vSemaphoreDelete(pe->done);
+    }
+    free(pe->erased);
+    free(pe->used);
+    memset(pe, 0, sizeof(*pe));
+}
+
+#endif // CONFIG_LITTLEFS_PREERASE
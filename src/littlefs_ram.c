@@ -0,0 +1,43 @@
+/**
+ * @file littlefs_ram.c
+ * @brief Maps a block array in RAM <-> littlefs
+ *
+ * Used for scratch filesystems that don't need to survive a reset. RAM can be
+ * overwritten in place, so erase and sync have nothing to do.
+ */
+
+#include <string.h>
+#include "littlefs_api.h"
+
+#ifdef CONFIG_LITTLEFS_RAM_SUPPORT
+
+int littlefs_ram_read(const struct lfs_config *c, lfs_block_t block,
+                      lfs_off_t off, void *buffer, lfs_size_t size)
+{
+    esp_littlefs_t * efs = c->context;
+    memcpy(buffer, efs->ram + (size_t)block * c->block_size + off, size);
+    return LFS_ERR_OK;
+}
+
+int littlefs_ram_write(const struct lfs_config *c, lfs_block_t block,
+                       lfs_off_t off, const void *buffer, lfs_size_t size)
+{
+    esp_littlefs_t * efs = c->context;
+    memcpy(efs->ram + (size_t)block * c->block_size + off, buffer, size);
+    return LFS_ERR_OK;
+}
+
+int littlefs_ram_erase(const struct lfs_config *c, lfs_block_t block)
+{
+    (void)c;
+    (void)block;
+    return LFS_ERR_OK;
+}
+
+int littlefs_ram_sync(const struct lfs_config *c)
+{
+    (void)c;
+    return LFS_ERR_OK;
+}
+
+#endif // CONFIG_LITTLEFS_RAM_SUPPORT
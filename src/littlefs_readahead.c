@@ -0,0 +1,79 @@
+/**
+ * @file littlefs_readahead.c
+ * @brief Sequential read-ahead for the partition and BDL read callbacks
+ *
+ * littlefs reads file data one cache_size chunk at a time. When consecutive
+ * reads walk forward through the device, the HAL prefetches a larger
+ * CONFIG_LITTLEFS_READAHEAD_SIZE window in one device access and serves
+ * the following reads from it.
+ */
+
+#include <string.h>
+#include <sys/param.h>
+#include "esp_log.h"
+#include "littlefs_api.h"
+
+#ifdef CONFIG_LITTLEFS_READAHEAD
+
+/* Number of back-to-back sequential reads before prefetching kicks in */
+#define READAHEAD_TRIGGER 2
+
+int littlefs_readahead_read(const struct lfs_config *c, uint64_t addr, void *buffer, size_t size,
+                            uint64_t dev_size, esp_littlefs_raw_read_t raw_read)
+{
+    esp_littlefs_t *efs = c->context;
+    esp_littlefs_readahead_t *ra = &efs->readahead;
+
+    /* Serve from the window */
+    if (ra->len && addr >= ra->start && addr + size <= ra->start + ra->len) {
+        memcpy(buffer, &ra->buf[addr - ra->start], size);
+        ra->next = addr + size;
+        return LFS_ERR_OK;
+    }
+
+    if (addr == ra->next) {
+        if (ra->streak < READAHEAD_TRIGGER) {
+            ra->streak++;
+        }
+    } else {
+        ra->streak = 0;
+    }
+    ra->next = addr + size;
+
+    if (ra->streak < READAHEAD_TRIGGER || size >= CONFIG_LITTLEFS_READAHEAD_SIZE) {
+        return raw_read(c, addr, buffer, size);
+    }
+
+    if (ra->buf == NULL) {
+        ra->buf = esp_littlefs_calloc(1, CONFIG_LITTLEFS_READAHEAD_SIZE);
+        if (ra->buf == NULL) {
+            /* Not fatal, just slower */
+            return raw_read(c, addr, buffer, size);
+        }
+    }
+
+    /* Prefetch from the requested address on; this runs over into the next block
+     * since littlefs tends to allocate the blocks of a file consecutively. */
+    size_t len = MIN((uint64_t)CONFIG_LITTLEFS_READAHEAD_SIZE, dev_size - addr);
+    ra->len = 0;
+    int res = raw_read(c, addr, ra->buf, len);
+    if (res != LFS_ERR_OK) {
+        return res;
+    }
+    ra->start = addr;
+    ra->len = len;
+
+    memcpy(buffer, ra->buf, size);
+    return LFS_ERR_OK;
+}
+
+void littlefs_readahead_invalidate(esp_littlefs_t *efs, uint64_t addr, size_t size)
+{
+    esp_littlefs_readahead_t *ra = &efs->readahead;
+
+    if (ra->len && addr < ra->start + ra->len && addr + size > ra->start) {
+        ra->len = 0;
+    }
+}
+
+#endif // CONFIG_LITTLEFS_READAHEAD
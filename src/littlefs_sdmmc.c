@@ -10,14 +10,73 @@
 
 #if CONFIG_LITTLEFS_SDMMC_SUPPORT
 
+/**
+ * @brief Map a littlefs (block, off, size) range onto an SD sector range.
+ *
+ * littlefs only issues reads/progs that are multiples of read_size/prog_size (one sector),
+ * so every request maps onto a whole number of contiguous sectors and can be
+ * transferred with a single multi-block command (CMD18/CMD25).
+ *
+ * @return 0 on success, LFS_ERR_INVAL if the range is not sector aligned.
+ */
+static int littlefs_sdmmc_sector_range(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, lfs_size_t size,
+                                       size_t *start_sector, size_t *sector_count)
+{
+    esp_littlefs_t * efs = c->context;
+    const size_t sector_size = efs->sdcard->csd.sector_size;
+    const uint64_t part_off = ((uint64_t)block * c->block_size) + off;
+
+    if ((part_off % sector_size) || (size % sector_size)) {
+        ESP_LOGE(ESP_LITTLEFS_TAG, "Unaligned SD access: block 0x%08lx, off 0x%08lx, size %lu (sector size %u)",
+                 (unsigned long)block, (unsigned long)off, (unsigned long)size, (unsigned)sector_size);
+        return LFS_ERR_INVAL;
+    }
+
+    *start_sector = part_off / sector_size;
+    *sector_count = size / sector_size;
+    return LFS_ERR_OK;
+}
+
+#if CONFIG_LITTLEFS_ERASE_POLICY_DEFERRED
+static int littlefs_sdmmc_discard(const struct lfs_config *c, lfs_block_t start, lfs_size_t count)
+{
+    esp_littlefs_t * efs = c->context;
+    const size_t sectors_per_block = c->block_size / efs->sdcard->csd.sector_size;
+    sdmmc_erase_arg_t arg = SDMMC_ERASE_ARG;
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 1, 0)
+    if (sdmmc_can_discard(efs->sdcard) == ESP_OK) {
+        arg = SDMMC_DISCARD_ARG;
+    }
+#endif
+
+    esp_err_t ret = sdmmc_erase_sectors(efs->sdcard, start * sectors_per_block, count * sectors_per_block, arg);
+    if (ret != ESP_OK) {
+        ESP_LOGE(ESP_LITTLEFS_TAG, "Failed to discard blocks %lu+%lu: ret=0x%x %s", start, count, ret, esp_err_to_name(ret));
+        return LFS_ERR_IO;
+    }
+
+#ifdef CONFIG_LITTLEFS_WEAR_TRACKING
+    littlefs_wear_note_erase(efs, start, count);
+#endif
+
+    return LFS_ERR_OK;
+}
+#endif
+
 int littlefs_sdmmc_read(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, void *buffer, lfs_size_t size)
 {
     esp_littlefs_t * efs = c->context;
-    uint32_t part_off = (block * c->block_size) + off;
+    size_t sector, count;
+
+    int res = littlefs_sdmmc_sector_range(c, block, off, size, &sector, &count);
+    if (res != LFS_ERR_OK) {
+        return res;
+    }
 
-    esp_err_t ret = sdmmc_read_sectors(efs->sdcard, buffer, block, MIN(size / efs->cfg.read_size, 1));
+    esp_err_t ret = sdmmc_read_sectors(efs->sdcard, buffer, sector, count);
     if (ret != ESP_OK) {
-        ESP_LOGE(ESP_LITTLEFS_TAG, "Failed to read addr 0x%08lx: off 0x%08lx, block 0x%08lx, size %lu, err=0x%x", part_off, off, block, size, ret);
+        ESP_LOGE(ESP_LITTLEFS_TAG, "Failed to read sector %u (+%u): off 0x%08lx, block 0x%08lx, size %lu, err=0x%x",
+                 (unsigned)sector, (unsigned)count, (unsigned long)off, (unsigned long)block, (unsigned long)size, ret);
         return LFS_ERR_IO;
     }
 
@@ -27,11 +86,24 @@ int littlefs_sdmmc_read(const struct lfs_config *c, lfs_block_t block, lfs_off_t
 int littlefs_sdmmc_write(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, const void *buffer, lfs_size_t size)
 {
     esp_littlefs_t * efs = c->context;
-    uint32_t part_off = (block * c->block_size) + off;
+    size_t sector, count;
 
-    esp_err_t ret = sdmmc_write_sectors(efs->sdcard, buffer, block, MIN(size / efs->cfg.prog_size, 1));
+    int res = littlefs_sdmmc_sector_range(c, block, off, size, &sector, &count);
+    if (res != LFS_ERR_OK) {
+        return res;
+    }
+
+#if CONFIG_LITTLEFS_ERASE_POLICY_DEFERRED
+    res = littlefs_erase_queue_cancel(c, block, littlefs_sdmmc_discard);
+    if (res != LFS_ERR_OK) {
+        return res;
+    }
+#endif
+
+    esp_err_t ret = sdmmc_write_sectors(efs->sdcard, buffer, sector, count);
     if (ret != ESP_OK) {
-        ESP_LOGE(ESP_LITTLEFS_TAG, "Failed to write addr 0x%08lx: off 0x%08lx, block 0x%08lx, size %lu, err=0x%x", part_off, off, block, size, ret);
+        ESP_LOGE(ESP_LITTLEFS_TAG, "Failed to write sector %u (+%u): off 0x%08lx, block 0x%08lx, size %lu, err=0x%x",
+                 (unsigned)sector, (unsigned)count, (unsigned long)off, (unsigned long)block, (unsigned long)size, ret);
         return LFS_ERR_IO;
     }
 
@@ -40,18 +112,33 @@ int littlefs_sdmmc_write(const struct lfs_config *c, lfs_block_t block, lfs_off_
 
 int littlefs_sdmmc_erase(const struct lfs_config *c, lfs_block_t block)
 {
+#if CONFIG_LITTLEFS_ERASE_POLICY_SKIP
+    return LFS_ERR_OK; // SD cards can be overwritten without erasing
+#elif CONFIG_LITTLEFS_ERASE_POLICY_DEFERRED
+    return littlefs_erase_queue_push(c, block, littlefs_sdmmc_discard);
+#else
     esp_littlefs_t * efs = c->context;
-    esp_err_t ret = sdmmc_erase_sectors(efs->sdcard, block, 1, SDMMC_ERASE_ARG);
+    const size_t sectors_per_block = c->block_size / efs->sdcard->csd.sector_size;
+    esp_err_t ret = sdmmc_erase_sectors(efs->sdcard, block * sectors_per_block, sectors_per_block, SDMMC_ERASE_ARG);
     if (ret != ESP_OK) {
         ESP_LOGE(ESP_LITTLEFS_TAG, "Failed to erase block %lu: ret=0x%x %s", block, ret, esp_err_to_name(ret));
         return LFS_ERR_IO;
     }
 
+#ifdef CONFIG_LITTLEFS_WEAR_TRACKING
+    littlefs_wear_note_erase(efs, block, 1);
+#endif
+
     return LFS_ERR_OK;
+#endif
 }
 
 int littlefs_sdmmc_sync(const struct lfs_config *c)
 {
+#if CONFIG_LITTLEFS_ERASE_POLICY_DEFERRED
+    return littlefs_erase_queue_flush(c, littlefs_sdmmc_discard);
+#else
     return LFS_ERR_OK; // Doesn't require & doesn't support sync
+#endif
 }
 #endif
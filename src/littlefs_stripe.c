@@ -0,0 +1,374 @@
+/**
+ * @file littlefs_stripe.c
+ * @brief Block device that stripes across two others
+ *
+ * The striped address space alternates between the members every `stripe`
+ * bytes: stripe n lives on member n % 2, at offset (n / 2) * stripe. The
+ * erase size is two stripes, so every erase LittleFS issues in classic mode
+ * hits both chips at once. A request that spans both members is split: the
+ * calling task does member 0's part while a worker task does member 1's.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/param.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_littlefs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "littlefs_api.h"
+
+#if ESP_LITTLEFS_HAS_BLOCKDEV && defined(CONFIG_LITTLEFS_STRIPE)
+
+typedef enum {
+    STRIPE_OP_READ,
+    STRIPE_OP_WRITE,
+    STRIPE_OP_ERASE,
+} stripe_op_t;
+
+typedef struct {
+    esp_blockdev_handle_t dev[2];
+    size_t                stripe;             /* Bytes per stripe */
+    SemaphoreHandle_t     lock;               /* Serializes requests */
+    TaskHandle_t          task;               /* Worker doing member 1's part of split requests */
+    SemaphoreHandle_t     done;               /* Given by the worker when its part is done */
+    volatile bool         stop;
+
+    /* Request handed to the worker */
+    stripe_op_t           op;
+    uint64_t              addr;
+    uint8_t              *buf;
+    size_t                len;
+    esp_err_t             result;
+} stripe_ctx_t;
+
+static size_t gcd(size_t a, size_t b)
+{
+    while (b) {
+        size_t t = b;
+        b = a % b;
+        a = t;
+    }
+    return a;
+}
+
+static size_t lcm_size(size_t a, size_t b)
+{
+    if (a == 0 || b == 0) {
+        return 0;
+    }
+    return a / gcd(a, b) * b;
+}
+
+/* Do the part of a striped request that lives on `member` */
+static esp_err_t stripe_member_io(stripe_ctx_t *ctx, unsigned member, stripe_op_t op,
+                                  uint64_t addr, uint8_t *buf, size_t len)
+{
+    esp_blockdev_handle_t dev = ctx->dev[member];
+    uint64_t erase_addr = 0;
+    size_t erase_len = 0;
+
+    while (len) {
+        const uint64_t n = addr / ctx->stripe;
+        const size_t off = addr % ctx->stripe;
+        const size_t chunk = MIN(len, ctx->stripe - off);
+
+        if (n % 2 == member) {
+            const uint64_t dev_addr = (n / 2) * ctx->stripe + off;
+            esp_err_t err = ESP_OK;
+
+            switch (op) {
+            case STRIPE_OP_READ:
+                err = dev->ops->read(dev, buf, chunk, dev_addr, chunk);
+                break;
+            case STRIPE_OP_WRITE:
+                err = dev->ops->write(dev, buf, dev_addr, chunk);
+                break;
+            case STRIPE_OP_ERASE:
+                /* Consecutive stripes of a member are adjacent on it; erase them in one go */
+                if (erase_len == 0) {
+                    erase_addr = dev_addr;
+                }
+                erase_len += chunk;
+                break;
+            }
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+
+        addr += chunk;
+        if (buf) {
+            buf += chunk;
+        }
+        len -= chunk;
+    }
+
+    if (erase_len) {
+        return dev->ops->erase(dev, erase_addr, erase_len);
+    }
+    return ESP_OK;
+}
+
+static esp_err_t stripe_io(esp_blockdev_handle_t dev_handle, stripe_op_t op,
+                           uint64_t addr, uint8_t *buf, size_t len)
+{
+    stripe_ctx_t *ctx = dev_handle ? dev_handle->ctx : NULL;
+    esp_err_t err, worker_err = ESP_OK;
+
+    if (!ctx || addr + len > dev_handle->geometry.disk_size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (len == 0) {
+        return ESP_OK;
+    }
+
+    const uint64_t first = addr / ctx->stripe;
+    const uint64_t last = (addr + len - 1) / ctx->stripe;
+
+    xSemaphoreTake(ctx->lock, portMAX_DELAY);
+    if (first == last) {
+        err = stripe_member_io(ctx, first % 2, op, addr, buf, len);
+    } else {
+        ctx->op = op;
+        ctx->addr = addr;
+        ctx->buf = buf;
+        ctx->len = len;
+        xTaskNotifyGive(ctx->task);
+        err = stripe_member_io(ctx, 0, op, addr, buf, len);
+        xSemaphoreTake(ctx->done, portMAX_DELAY);
+        worker_err = ctx->result;
+    }
+    xSemaphoreGive(ctx->lock);
+
+    return err != ESP_OK ? err : worker_err;
+}
+
+static esp_err_t stripe_read(esp_blockdev_handle_t dev_handle, uint8_t *dst_buf,
+                             size_t dst_buf_size, uint64_t src_addr, size_t data_read_len)
+{
+    if (!dst_buf || data_read_len > dst_buf_size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return stripe_io(dev_handle, STRIPE_OP_READ, src_addr, dst_buf, data_read_len);
+}
+
+static esp_err_t stripe_write(esp_blockdev_handle_t dev_handle, const uint8_t *src_buf,
+                              uint64_t dst_addr, size_t data_write_len)
+{
+    if (!src_buf) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    /* The buffer is only read from on the write path */
+    return stripe_io(dev_handle, STRIPE_OP_WRITE, dst_addr, (uint8_t *)src_buf, data_write_len);
+}
+
+static esp_err_t stripe_erase(esp_blockdev_handle_t dev_handle, uint64_t start_addr, size_t erase_len)
+{
+    return stripe_io(dev_handle, STRIPE_OP_ERASE, start_addr, NULL, erase_len);
+}
+
+static esp_err_t stripe_sync(esp_blockdev_handle_t dev_handle)
+{
+    stripe_ctx_t *ctx = dev_handle ? dev_handle->ctx : NULL;
+    esp_err_t err = ESP_OK;
+
+    if (!ctx) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(ctx->lock, portMAX_DELAY);
+    for (int i = 0; i < 2 && err == ESP_OK; i++) {
+        if (ctx->dev[i]->ops->sync) {
+            err = ctx->dev[i]->ops->sync(ctx->dev[i]);
+        }
+    }
+    xSemaphoreGive(ctx->lock);
+    return err;
+}
+
+static void stripe_ctx_free(stripe_ctx_t *ctx)
+{
+    if (ctx->task) {
+        ctx->stop = true;
+        xTaskNotifyGive(ctx->task);
+        xSemaphoreTake(ctx->done, portMAX_DELAY);
+    }
+    if (ctx->done) {
+        vSemaphoreDelete(ctx->done);
+    }
+    if (ctx->lock) {
+        vSemaphoreDelete(ctx->lock);
+    }
+    free(ctx);
+}
+
+static esp_err_t stripe_release(esp_blockdev_handle_t dev_handle)
+{
+    if (!dev_handle || !dev_handle->ctx) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    stripe_ctx_t *ctx = dev_handle->ctx;
+    esp_err_t err = ESP_OK;
+    for (int i = 0; i < 2; i++) {
+        esp_blockdev_handle_t member = ctx->dev[i];
+        if (member->ops && member->ops->release) {
+            esp_err_t res = member->ops->release(member);
+            if (err == ESP_OK) {
+                err = res;
+            }
+        }
+    }
+
+    stripe_ctx_free(ctx);
+    free(dev_handle);
+    return err;
+}
+
+static const esp_blockdev_ops_t s_stripe_ops = {
+    .read = stripe_read,
+    .write = stripe_write,
+    .erase = stripe_erase,
+    .sync = stripe_sync,
+    .ioctl = NULL,
+    .release = stripe_release,
+};
+
+static void stripe_task(void *arg)
+{
+    stripe_ctx_t *ctx = arg;
+
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (ctx->stop) {
+            break;
+        }
+        ctx->result = stripe_member_io(ctx, 1, ctx->op, ctx->addr, ctx->buf, ctx->len);
+        xSemaphoreGive(ctx->done);
+    }
+
+    xSemaphoreGive(ctx->done);
+    vTaskDelete(NULL);
+}
+
+static bool stripe_flags_equal(const esp_blockdev_flags_t *a, const esp_blockdev_flags_t *b)
+{
+    return a->read_only == b->read_only &&
+           a->encrypted == b->encrypted &&
+           a->erase_before_write == b->erase_before_write &&
+           a->and_type_write == b->and_type_write &&
+           a->default_val_after_erase == b->default_val_after_erase;
+}
+
+/* Preferred unit of a member: the recommended size when it's a multiple of the minimum */
+static size_t stripe_preferred(size_t min, size_t recommended)
+{
+    return (recommended > 0 && min > 0 && recommended % min == 0) ? recommended : min;
+}
+
+esp_err_t esp_littlefs_stripe_bdl_create(esp_blockdev_handle_t dev0, esp_blockdev_handle_t dev1,
+                                         size_t stripe_size, esp_blockdev_handle_t *out)
+{
+    if (!dev0 || !dev1 || dev0 == dev1 || !out || !dev0->ops || !dev1->ops ||
+            !dev0->ops->read || !dev1->ops->read) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    /* Writes and erases are forwarded to the members as-is */
+    for (int i = 0; i < 2; i++) {
+        const esp_blockdev_handle_t dev = i ? dev1 : dev0;
+        if (!dev->device_flags.read_only && (!dev->ops->write || !dev->ops->erase)) {
+            ESP_LOGE(ESP_LITTLEFS_TAG, "Writable striped block devices must provide write and erase");
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+    if (!stripe_flags_equal(&dev0->device_flags, &dev1->device_flags)) {
+        ESP_LOGE(ESP_LITTLEFS_TAG, "Striped block devices must have the same device flags");
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    const esp_blockdev_geometry_t *g0 = &dev0->geometry;
+    const esp_blockdev_geometry_t *g1 = &dev1->geometry;
+    const bool classic = dev0->device_flags.erase_before_write || dev0->device_flags.and_type_write;
+
+    const size_t read_size = lcm_size(g0->read_size, g1->read_size);
+    const size_t write_size = lcm_size(g0->write_size, g1->write_size);
+    const size_t rec_read_size = lcm_size(stripe_preferred(g0->read_size, g0->recommended_read_size),
+                                          stripe_preferred(g1->read_size, g1->recommended_read_size));
+    const size_t rec_write_size = lcm_size(stripe_preferred(g0->write_size, g0->recommended_write_size),
+                                           stripe_preferred(g1->write_size, g1->recommended_write_size));
+    if (read_size == 0 || write_size == 0) {
+        ESP_LOGE(ESP_LITTLEFS_TAG, "Striped block devices must report read and write sizes");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    /* Every stripe must start on an erase, read and write boundary of its member */
+    size_t unit = lcm_size(read_size, write_size);
+    if (classic) {
+        unit = lcm_size(unit, lcm_size(g0->erase_size, g1->erase_size));
+        if (unit == 0) {
+            ESP_LOGE(ESP_LITTLEFS_TAG, "Striped block devices must report an erase size");
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+    const size_t stripe = stripe_size ? stripe_size : unit;
+    if (stripe % unit != 0) {
+        ESP_LOGE(ESP_LITTLEFS_TAG, "Stripe size %u is not a multiple of %u", (unsigned)stripe, (unsigned)unit);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    const uint64_t member_size = MIN(g0->disk_size, g1->disk_size) / stripe * stripe;
+    if (member_size == 0) {
+        ESP_LOGE(ESP_LITTLEFS_TAG, "Striped block devices are smaller than one stripe (%u)", (unsigned)stripe);
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (g0->disk_size != g1->disk_size) {
+        ESP_LOGW(ESP_LITTLEFS_TAG, "Striped block devices differ in size; only %" PRIu64 " bytes of each are used",
+                 member_size);
+    }
+
+    esp_blockdev_handle_t dev = calloc(1, sizeof(*dev));
+    stripe_ctx_t *ctx = calloc(1, sizeof(*ctx));
+    if (!dev || !ctx) {
+        free(ctx);
+        free(dev);
+        return ESP_ERR_NO_MEM;
+    }
+
+    ctx->dev[0] = dev0;
+    ctx->dev[1] = dev1;
+    ctx->stripe = stripe;
+    ctx->lock = xSemaphoreCreateMutex();
+    ctx->done = xSemaphoreCreateBinary();
+    if (!ctx->lock || !ctx->done ||
+            xTaskCreate(stripe_task, "littlefs_stripe", CONFIG_LITTLEFS_STRIPE_TASK_STACK, ctx,
+                        CONFIG_LITTLEFS_STRIPE_TASK_PRIORITY, &ctx->task) != pdPASS) {
+        ESP_LOGE(ESP_LITTLEFS_TAG, "stripe worker could not be created");
+        ctx->task = NULL;
+        stripe_ctx_free(ctx);
+        free(dev);
+        return ESP_ERR_NO_MEM;
+    }
+
+    dev->ctx = ctx;
+    dev->device_flags = dev0->device_flags;
+    dev->geometry.disk_size = 2 * member_size;
+    dev->geometry.read_size = read_size;
+    dev->geometry.write_size = write_size;
+    dev->geometry.erase_size = 2 * stripe;
+    dev->geometry.recommended_read_size = rec_read_size != read_size ? rec_read_size : 0;
+    dev->geometry.recommended_write_size = rec_write_size != write_size ? rec_write_size : 0;
+    dev->geometry.recommended_erase_size = 0;
+    dev->ops = &s_stripe_ops;
+
+    *out = dev;
+    return ESP_OK;
+}
+
+#endif // ESP_LITTLEFS_HAS_BLOCKDEV && CONFIG_LITTLEFS_STRIPE
@@ -0,0 +1,224 @@
+/**
+ * @file littlefs_wear.c
+ * @brief Per-block erase counters, kept in RAM and periodically saved to NVS
+ *
+ * Counts the erases littlefs requests for each block, which is what
+ * CONFIG_LITTLEFS_BLOCK_CYCLES spreads out. A block erased ahead of time by the
+ * pre-erase pool is counted once, when the pre-erase happens.
+ *
+ * Counters are persisted under a hash of the partition label, in NVS blobs of
+ * WEAR_CHUNK_BLOCKS counters, so they survive reboots for flash partitions. SD cards and blockdevs have no stable name and are tracked
+ * in RAM only.
+ */
+
+#include <inttypes.h>
+#include <string.h>
+#include <sys/param.h>
+#include "esp_log.h"
+#include "littlefs_api.h"
+
+#ifdef CONFIG_LITTLEFS_WEAR_TRACKING
+
+#if CONFIG_LITTLEFS_WEAR_PERSIST_INTERVAL
+#include <stdio.h>
+#include "nvs.h"
+
+#define WEAR_NVS_NAMESPACE "littlefs_wear"
+#define WEAR_CHUNK_BLOCKS  128 /* Counters per NVS blob; keeps each blob to 512 bytes */
+
+/*
+ * Labels can be longer than an NVS key, so counters are saved under a hash of
+ * the label. The label itself is stored under the bare hash, so a collision is
+ * noticed instead of two partitions sharing counters.
+ */
+static uint32_t wear_label_hash(const char *label)
+{
+    uint32_t hash = 2166136261u; /* FNV-1a */
+    while (*label) {
+        hash = (hash ^ (uint8_t)*label++) * 16777619u;
+    }
+    return hash;
+}
+
+static void wear_chunk_key(const esp_littlefs_wear_t *wear, size_t chunk, char key[NVS_KEY_NAME_MAX_SIZE])
+{
+    snprintf(key, NVS_KEY_NAME_MAX_SIZE, "%s_%x", wear->key, (unsigned)chunk);
+}
+
+static size_t wear_chunk_count(const esp_littlefs_wear_t *wear)
+{
+    return (wear->block_count + WEAR_CHUNK_BLOCKS - 1) / WEAR_CHUNK_BLOCKS;
+}
+
+static size_t wear_chunk_size(const esp_littlefs_wear_t *wear, size_t chunk)
+{
+    return MIN(WEAR_CHUNK_BLOCKS, wear->block_count - chunk * WEAR_CHUNK_BLOCKS) * sizeof(uint32_t);
+}
+
+static void wear_load(esp_littlefs_wear_t *wear, const char *label)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(WEAR_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return;
+    }
+
+    char saved_label[sizeof(((esp_partition_t *)0)->label)];
+    size_t size = sizeof(saved_label);
+    esp_err_t err = nvs_get_str(nvs, wear->key, saved_label, &size);
+    if (err == ESP_OK && strcmp(saved_label, label) != 0) {
+        ESP_LOGW(ESP_LITTLEFS_TAG, "erase counters of \"%s\" collide with \"%s\" in NVS, not saving them",
+                 label, saved_label);
+        wear->key[0] = '\0';
+    } else if (err == ESP_OK) {
+        /* Keep what still applies if the filesystem was grown/shrunk since */
+        for (size_t i = 0; i < wear_chunk_count(wear); i++) {
+            char key[NVS_KEY_NAME_MAX_SIZE];
+            wear_chunk_key(wear, i, key);
+            size = wear_chunk_size(wear, i);
+            nvs_get_blob(nvs, key, wear->counts + i * WEAR_CHUNK_BLOCKS, &size);
+        }
+        wear->label_saved = true;
+    }
+    nvs_close(nvs);
+}
+
+static void wear_save(esp_littlefs_wear_t *wear, const char *label)
+{
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(WEAR_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err == ESP_OK) {
+        if (!wear->label_saved) {
+            err = nvs_set_str(nvs, wear->key, label);
+            wear->label_saved = err == ESP_OK;
+        }
+        /* Only the chunks that changed are rewritten */
+        for (size_t i = 0; err == ESP_OK && i < wear_chunk_count(wear); i++) {
+            if (wear->dirty[i]) {
+                char key[NVS_KEY_NAME_MAX_SIZE];
+                wear_chunk_key(wear, i, key);
+                err = nvs_set_blob(nvs, key, wear->counts + i * WEAR_CHUNK_BLOCKS, wear_chunk_size(wear, i));
+                wear->dirty[i] = err != ESP_OK;
+            }
+        }
+        if (err == ESP_OK) {
+            err = nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
+    if (err != ESP_OK) {
+        /* Chunks not saved stay dirty and are retried at the next save */
+        ESP_LOGW(ESP_LITTLEFS_TAG, "failed to save erase counters of \"%s\": %s", label, esp_err_to_name(err));
+    }
+    wear->unsaved = 0;
+}
+#endif // CONFIG_LITTLEFS_WEAR_PERSIST_INTERVAL
+
+esp_err_t esp_littlefs_wear_init(esp_littlefs_t *efs)
+{
+    esp_littlefs_wear_t *wear = &efs->wear;
+    const lfs_size_t block_count = efs->fs->block_count;
+
+    if (block_count > CONFIG_LITTLEFS_WEAR_MAX_BLOCKS) {
+        ESP_LOGW(ESP_LITTLEFS_TAG, "%u blocks is more than CONFIG_LITTLEFS_WEAR_MAX_BLOCKS, wear is not tracked",
+                 (unsigned)block_count);
+        return ESP_OK;
+    }
+
+    wear->counts = esp_littlefs_calloc(block_count, sizeof(uint32_t));
+    if (wear->counts == NULL) {
+        ESP_LOGE(ESP_LITTLEFS_TAG, "erase counters could not be malloced");
+        return ESP_ERR_NO_MEM;
+    }
+    wear->block_count = block_count;
+
+#if CONFIG_LITTLEFS_WEAR_PERSIST_INTERVAL
+    if (efs->partition) {
+        wear->dirty = esp_littlefs_calloc(wear_chunk_count(wear), sizeof(bool));
+        if (wear->dirty == NULL) {
+            ESP_LOGE(ESP_LITTLEFS_TAG, "erase counters could not be malloced");
+            free(wear->counts);
+            memset(wear, 0, sizeof(*wear));
+            return ESP_ERR_NO_MEM;
+        }
+        snprintf(wear->key, sizeof(wear->key), "%08"PRIx32, wear_label_hash(efs->partition->label));
+        wear_load(wear, efs->partition->label);
+    }
+#endif
+    return ESP_OK;
+}
+
+void esp_littlefs_wear_deinit(esp_littlefs_t *efs)
+{
+    esp_littlefs_wear_t *wear = &efs->wear;
+
+    esp_littlefs_wear_save(efs, true);
+#if CONFIG_LITTLEFS_WEAR_PERSIST_INTERVAL
+    free(wear->dirty);
+#endif
+    free(wear->counts);
+    memset(wear, 0, sizeof(*wear));
+}
+
+void esp_littlefs_wear_save(esp_littlefs_t *efs, bool force)
+{
+#if CONFIG_LITTLEFS_WEAR_PERSIST_INTERVAL
+    esp_littlefs_wear_t *wear = &efs->wear;
+
+    if (wear->counts && wear->key[0] && wear->unsaved
+            && (force || wear->unsaved >= CONFIG_LITTLEFS_WEAR_PERSIST_INTERVAL)) {
+        wear_save(wear, efs->partition->label);
+    }
+#endif
+}
+
+void littlefs_wear_note_erase(esp_littlefs_t *efs, lfs_block_t block, lfs_size_t count)
+{
+    esp_littlefs_wear_t *wear = &efs->wear;
+
+    if (wear->counts == NULL) {
+        return;
+    }
+    for (lfs_size_t i = 0; i < count && block + i < wear->block_count; i++) {
+        wear->counts[block + i]++;
+#if CONFIG_LITTLEFS_WEAR_PERSIST_INTERVAL
+        if (wear->dirty) {
+            wear->dirty[(block + i) / WEAR_CHUNK_BLOCKS] = true;
+        }
+#endif
+    }
+
+#if CONFIG_LITTLEFS_WEAR_PERSIST_INTERVAL
+    /* Saved later by esp_littlefs_wear_save(), not from inside the erase */
+    wear->unsaved += count;
+#endif
+}
+
+void esp_littlefs_wear_get_stats(esp_littlefs_t *efs, esp_littlefs_wear_stats_t *stats)
+{
+    const esp_littlefs_wear_t *wear = &efs->wear;
+    uint64_t total = 0;
+
+    memset(stats, 0, sizeof(*stats));
+    if (wear->counts == NULL || wear->block_count == 0) {
+        return;
+    }
+
+    stats->min = UINT32_MAX;
+    for (lfs_size_t i = 0; i < wear->block_count; i++) {
+        stats->min = MIN(stats->min, wear->counts[i]);
+        stats->max = MAX(stats->max, wear->counts[i]);
+        total += wear->counts[i];
+    }
+    stats->blocks = wear->block_count;
+    stats->total = total;
+    stats->mean = total / wear->block_count;
+
+    /* Spread the buckets evenly over [min, max] */
+    stats->hist_min = stats->min;
+    stats->hist_width = (stats->max - stats->min) / ESP_LITTLEFS_WEAR_HIST_BUCKETS + 1;
+    for (lfs_size_t i = 0; i < wear->block_count; i++) {
+        stats->hist[(wear->counts[i] - stats->min) / stats->hist_width]++;
+    }
+}
+
+#endif // CONFIG_LITTLEFS_WEAR_TRACKING
@@ -1,5 +1,6 @@
 #include "test_littlefs_common.h"
 #include "esp_vfs_fat.h"
+#include "esp_cpu.h"
 
 static const char TAG[] = "[littlefs_benchmark]";
 
@@ -213,6 +214,60 @@ static void read_write_test_1(const char *mount_pt, uint32_t iter) {
 }
 
 
+/**
+ * @brief Sequentially writes then reads back a single large file in fixed-size chunks.
+ *
+ * Reports throughput in MB/s; useful for comparing backends whose HAL
+ * merges multi-sector transfers (e.g. SD cards) against single-sector access.
+ *
+ * @param[in] mount_pt
+ * @param[in] total Number of bytes to write/read
+ * @param[in] chunk Size of each fwrite/fread call
+ */
+static void sequential_rw_test(const char *mount_pt, size_t total, size_t chunk) {
+    char fname[128] = { 0 };
+    snprintf(fname, sizeof(fname), "%s/seq.bin", mount_pt);
+
+    uint8_t *buf = malloc(chunk);
+    TEST_ASSERT_NOT_NULL(buf);
+    for(size_t i=0; i < chunk; i++) buf[i] = (uint8_t)i;
+
+    /* WRITE */
+    uint64_t t_start = esp_timer_get_time();
+    FILE* f = fopen(fname, "wb");
+    TEST_ASSERT_NOT_NULL(f);
+    setvbuf(f, NULL, _IONBF, 0);
+    size_t n_write = 0;
+    while(n_write < total) {
+        size_t n = fwrite(buf, 1, MIN(chunk, total - n_write), f);
+        if(n == 0) break;
+        n_write += n;
+    }
+    fclose(f);
+    uint64_t t_write = esp_timer_get_time() - t_start;
+
+    /* READ */
+    t_start = esp_timer_get_time();
+    f = fopen(fname, "rb");
+    TEST_ASSERT_NOT_NULL(f);
+    setvbuf(f, NULL, _IONBF, 0);
+    size_t n_read = 0;
+    size_t n;
+    while((n = fread(buf, 1, chunk, f)) > 0) n_read += n;
+    fclose(f);
+    uint64_t t_read = esp_timer_get_time() - t_start;
+
+    unlink(fname);
+    free(buf);
+
+    TEST_ASSERT_EQUAL(n_write, n_read);
+    printf("%u byte chunks: wrote %u bytes in %lld us (%.3f MB/s), read in %lld us (%.3f MB/s)\n",
+            chunk, n_write,
+            t_write, (double)n_write / t_write,
+            t_read, (double)n_read / t_read);
+}
+
+
 TEST_CASE("Format", TAG){
     uint64_t t_fat, t_spiffs, t_littlefs, t_start;
 
@@ -253,3 +308,369 @@ TEST_CASE("Write 5 files, read 5 files, then delete 5 files", TAG){
 
     test_benchmark_teardown();
 }
+
+TEST_CASE("Sequential read/write throughput", TAG){
+    const size_t chunks[] = {512, 4096, 16384};
+    test_benchmark_setup();
+
+    for(size_t i=0; i < sizeof(chunks)/sizeof(chunks[0]); i++) {
+        printf("FAT:\n");
+        sequential_rw_test("/fat", 128 * 1024, chunks[i]);
+        printf("SPIFFS:\n");
+        sequential_rw_test("/spiffs", 128 * 1024, chunks[i]);
+        printf("LittleFS:\n");
+        sequential_rw_test("/littlefs", 128 * 1024, chunks[i]);
+        printf("\n");
+    }
+
+    test_benchmark_teardown();
+}
+
+TEST_CASE("First fill of a blank partition", TAG){
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "flash_test");
+    TEST_ASSERT_NOT_NULL(part);
+
+    /* Start from a completely blank partition, like a freshly flashed device */
+    TEST_ESP_OK(esp_partition_erase_range(part, 0, part->size));
+
+    esp_vfs_littlefs_conf_t conf = {
+        .base_path = "/littlefs",
+        .partition_label = "flash_test",
+        .format_if_mount_failed = true
+    };
+    TEST_ESP_OK(esp_vfs_littlefs_register(&conf));
+
+    printf("LittleFS first fill:\n");
+    sequential_rw_test("/littlefs", part->size / 2, 4096);
+
+#ifdef CONFIG_LITTLEFS_ERASE_BLANK_CHECK
+    uint32_t erase_skipped = 0;
+    TEST_ESP_OK(esp_littlefs_erase_skipped("flash_test", &erase_skipped));
+    printf("Skipped %"PRIu32" erases of already blank blocks\n", erase_skipped);
+#endif
+
+    TEST_ESP_OK(esp_vfs_littlefs_unregister("flash_test"));
+}
+
+TEST_CASE("Read throughput by read path", TAG){
+    /* Build with different sdkconfigs to compare the read paths */
+#if defined(CONFIG_LITTLEFS_MMAP_ZERO_COPY_READ)
+    const char *mode = "zero-copy mmap";
+#elif defined(CONFIG_LITTLEFS_MMAP_PARTITION)
+    const char *mode = "mmap";
+#else
+    const char *mode = "esp_partition_read";
+#endif
+    const size_t chunks[] = {64, 512, 4096};
+    esp_vfs_littlefs_conf_t conf = {
+        .base_path = "/littlefs",
+        .partition_label = "flash_test",
+        .format_if_mount_failed = true
+    };
+    TEST_ESP_OK(esp_littlefs_format(conf.partition_label));
+    TEST_ESP_OK(esp_vfs_littlefs_register(&conf));
+
+    printf("LittleFS (%s):\n", mode);
+    for(size_t i=0; i < sizeof(chunks)/sizeof(chunks[0]); i++) {
+        sequential_rw_test("/littlefs", 128 * 1024, chunks[i]);
+    }
+
+    TEST_ESP_OK(esp_vfs_littlefs_unregister(conf.partition_label));
+}
+
+static int cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Time small appended writes (each followed by fsync) separated by idle
+ *        gaps, and print the latency distribution.
+ *
+ * @param[in] conf Mount configuration to benchmark
+ */
+static void write_latency_test(const esp_vfs_littlefs_conf_t *conf) {
+    const int iter = 256;
+    uint8_t buf[1024];
+    memset(buf, 0x5A, sizeof(buf));
+
+    uint32_t *lat = calloc(iter, sizeof(uint32_t));
+    TEST_ASSERT_NOT_NULL(lat);
+
+    TEST_ESP_OK(esp_littlefs_format(conf->partition_label));
+    TEST_ESP_OK(esp_vfs_littlefs_register(conf));
+
+    int fd = open("/littlefs/latency.bin", O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+    for(int i=0; i < iter; i++) {
+        /* Leave the filesystem idle for a bit, as a logging application would */
+        vTaskDelay(pdMS_TO_TICKS(20));
+        uint64_t t_start = esp_timer_get_time();
+        TEST_ASSERT_EQUAL(sizeof(buf), write(fd, buf, sizeof(buf)));
+        TEST_ASSERT_EQUAL(0, fsync(fd));
+        lat[i] = esp_timer_get_time() - t_start;
+    }
+    close(fd);
+
+    TEST_ESP_OK(esp_vfs_littlefs_unregister(conf->partition_label));
+
+    qsort(lat, iter, sizeof(uint32_t), cmp_u32);
+    printf("write+fsync latency: p50 %"PRIu32" us, p99 %"PRIu32" us, max %"PRIu32" us\n",
+            lat[iter / 2], lat[iter * 99 / 100], lat[iter - 1]);
+    free(lat);
+}
+
+TEST_CASE("Write latency with idle gaps", TAG){
+    esp_vfs_littlefs_conf_t conf = {
+        .base_path = "/littlefs",
+        .partition_label = "flash_test",
+        .format_if_mount_failed = true
+    };
+
+    printf("LittleFS:\n");
+    write_latency_test(&conf);
+
+#ifdef CONFIG_LITTLEFS_PREERASE
+    conf.preerase = true;
+    printf("LittleFS with pre-erase pool:\n");
+    write_latency_test(&conf);
+#endif
+}
+
+#if CONFIG_LITTLEFS_PREERASE_COALESCE_SIZE
+/**
+ * @brief Program the whole partition, so every block littlefs allocates needs a real erase.
+ */
+static void dirty_partition(const esp_partition_t *part) {
+    uint8_t *buf = calloc(1, 4096);
+    TEST_ASSERT_NOT_NULL(buf);
+    TEST_ESP_OK(esp_partition_erase_range(part, 0, part->size));
+    for(size_t off=0; off < part->size; off += 4096) {
+        TEST_ESP_OK(esp_partition_write(part, off, buf, 4096));
+    }
+    free(buf);
+}
+
+TEST_CASE("Bulk write with coalesced erases", TAG){
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "flash_test");
+    TEST_ASSERT_NOT_NULL(part);
+    esp_vfs_littlefs_conf_t conf = {
+        .base_path = "/littlefs",
+        .partition_label = "flash_test",
+        .format_if_mount_failed = true
+    };
+
+    for(int coalesce=0; coalesce < 2; coalesce++) {
+        dirty_partition(part);
+        TEST_ESP_OK(esp_littlefs_format(conf.partition_label));
+        conf.preerase = coalesce;
+        TEST_ESP_OK(esp_vfs_littlefs_register(&conf));
+
+        printf("LittleFS%s:\n", coalesce ? " with coalesced erases" : "");
+        sequential_rw_test("/littlefs", part->size / 2, 4096);
+
+        TEST_ESP_OK(esp_vfs_littlefs_unregister(conf.partition_label));
+    }
+}
+#endif
+
+uint32_t lfs_crc(uint32_t crc, const void *buffer, size_t size);
+
+TEST_CASE("lfs_crc cycles per byte", TAG){
+    /* Build with different sdkconfigs to compare the CRC implementations */
+#if defined(CONFIG_LITTLEFS_CRC_ROM)
+    const char *mode = "ROM";
+#elif defined(CONFIG_LITTLEFS_CRC_SLICING8)
+    const char *mode = "slicing-by-8";
+#else
+    const char *mode = "small table";
+#endif
+    const size_t sizes[] = {16, 256, 4096};
+    const size_t total = 256 * 1024;
+
+    /* Standard CRC-32 check value; littlefs does not apply the final xor */
+    TEST_ASSERT_EQUAL_HEX32(0xCBF43926, lfs_crc(0xffffffff, "123456789", 9) ^ 0xffffffff);
+
+    uint8_t *buf = malloc(sizes[2]);
+    TEST_ASSERT_NOT_NULL(buf);
+    for(size_t i=0; i < sizes[2]; i++) {
+        buf[i] = i * 31;
+    }
+
+    printf("lfs_crc (%s):\n", mode);
+    for(size_t i=0; i < sizeof(sizes)/sizeof(sizes[0]); i++) {
+        uint32_t crc = 0xffffffff;
+        /* Offset by one byte so the unaligned head is exercised too */
+        const uint8_t *data = buf + (sizes[i] < sizes[2] ? 1 : 0);
+        uint32_t t_start = esp_cpu_get_cycle_count();
+        for(size_t n=0; n < total; n += sizes[i]) {
+            crc = lfs_crc(crc, data, sizes[i]);
+        }
+        uint32_t cycles = esp_cpu_get_cycle_count() - t_start;
+        printf("%5u B buffers: %"PRIu32".%02"PRIu32" cycles/byte (crc %08"PRIx32")\n",
+                (unsigned)sizes[i], cycles / total, (uint32_t)((cycles % total) * 100 / total), crc);
+    }
+    free(buf);
+}
+
+TEST_CASE("open/close latency by number of open files", TAG){
+    /* The VFS caps the file descriptors of all filesystems together (CONFIG_LWIP_MAX_SOCKETS
+     * and FD_SETSIZE), so the larger counts may not be reachable */
+    const int counts[] = {1, 16, 128, 512};
+    const int iter = 256;
+    const char *path = "/littlefs/openclose.txt";
+    esp_vfs_littlefs_conf_t conf = {
+        .base_path = "/littlefs",
+        .partition_label = "flash_test",
+        .format_if_mount_failed = true
+    };
+    TEST_ESP_OK(esp_littlefs_format(conf.partition_label));
+    TEST_ESP_OK(esp_vfs_littlefs_register(&conf));
+    test_littlefs_create_file_with_text(path, littlefs_test_hello_str);
+
+    int *held = calloc(counts[3], sizeof(int));
+    TEST_ASSERT_NOT_NULL(held);
+    int n_held = 0;
+
+    for(size_t c=0; c < sizeof(counts)/sizeof(counts[0]); c++) {
+        /* Keep counts[c] - 1 files open, the measured one makes it counts[c] */
+        while(n_held < counts[c] - 1) {
+            int fd = open(path, O_RDONLY);
+            if(fd < 0) break;
+            held[n_held++] = fd;
+        }
+        if(n_held < counts[c] - 1) {
+            printf("%4d open files: not reached, open failed after %d (errno %d)\n", counts[c], n_held, errno);
+            break;
+        }
+
+        uint64_t t_start = esp_timer_get_time();
+        for(int i=0; i < iter; i++) {
+            int fd = open(path, O_RDONLY);
+            TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+            TEST_ASSERT_EQUAL(0, close(fd));
+        }
+        uint64_t t_total = esp_timer_get_time() - t_start;
+        printf("%4d open files: %"PRIu32" us per open+close\n", counts[c], (uint32_t)(t_total / iter));
+    }
+
+    while(n_held > 0) {
+        TEST_ASSERT_EQUAL(0, close(held[--n_held]));
+    }
+    free(held);
+    TEST_ESP_OK(esp_vfs_littlefs_unregister(conf.partition_label));
+}
+
+/**
+ * @brief Time open+write+close of an existing file, and count the flash programs it takes if available.
+ */
+static void open_write_close_test(const char *label, const char *path, int flags, const char *name) {
+    const int iter = 64;
+    const char line[] = "0123456789abcdef";
+#ifdef CONFIG_LITTLEFS_IO_STATS
+    esp_littlefs_io_stats_t io;
+    TEST_ESP_OK(esp_littlefs_io_stats(label, NULL, true));
+#endif
+
+    uint64_t t_start = esp_timer_get_time();
+    for(int i=0; i < iter; i++) {
+        int fd = open(path, flags, 0666);
+        TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+        TEST_ASSERT_EQUAL(sizeof(line) - 1, write(fd, line, sizeof(line) - 1));
+        TEST_ASSERT_EQUAL(0, close(fd));
+    }
+    uint64_t t_total = esp_timer_get_time() - t_start;
+
+#ifdef CONFIG_LITTLEFS_IO_STATS
+    TEST_ESP_OK(esp_littlefs_io_stats(label, &io, false));
+    printf("%-8s %"PRIu32" us per open+write+close, %"PRIu32" progs per iteration\n",
+            name, (uint32_t)(t_total / iter), io.prog.count / iter);
+#else
+    printf("%-8s %"PRIu32" us per open+write+close\n", name, (uint32_t)(t_total / iter));
+#endif
+}
+
+TEST_CASE("open-append-close latency", TAG){
+    /* Check out the tree before sync-on-open was limited to O_TRUNC to compare */
+    const char *path = "/littlefs/append.txt";
+    esp_vfs_littlefs_conf_t conf = {
+        .base_path = "/littlefs",
+        .partition_label = "flash_test",
+        .format_if_mount_failed = true
+    };
+    TEST_ESP_OK(esp_littlefs_format(conf.partition_label));
+    TEST_ESP_OK(esp_vfs_littlefs_register(&conf));
+    test_littlefs_create_file_with_text(path, littlefs_test_hello_str);
+
+    open_write_close_test(conf.partition_label, path, O_WRONLY | O_APPEND, "append:");
+    open_write_close_test(conf.partition_label, path, O_RDWR, "r+:");
+    open_write_close_test(conf.partition_label, path, O_WRONLY | O_TRUNC, "truncate:");
+
+    TEST_ESP_OK(esp_vfs_littlefs_unregister(conf.partition_label));
+}
+
+/**
+ * @brief Time pread of records at pseudo-random offsets, optionally interleaved with sequential reads.
+ *
+ * @param[in] fd     File to read
+ * @param[in] size   Size of the file
+ * @param[in] span   Offsets are picked from the first `span` bytes of the file
+ * @param[in] interleave Also read() the next record sequentially after every pread
+ * @param[in] name   Label to print the result with
+ */
+static void random_pread_test(int fd, size_t size, size_t span, bool interleave, const char *name) {
+    const int iter = 512;
+    const size_t record = 64;
+    uint8_t buf[64];
+    uint32_t seed = 1;
+
+    TEST_ASSERT_EQUAL(0, lseek(fd, 0, SEEK_SET));
+    uint64_t t_start = esp_timer_get_time();
+    for(int i=0; i < iter; i++) {
+        seed = seed * 1103515245 + 12345;
+        off_t offset = (seed >> 8) % (MIN(span, size) - record);
+        TEST_ASSERT_EQUAL(record, pread(fd, buf, record, offset));
+        if(interleave) {
+            TEST_ASSERT_EQUAL(record, read(fd, buf, record));
+        }
+    }
+    uint64_t t_total = esp_timer_get_time() - t_start;
+    printf("%-34s %"PRIu32" us per iteration\n", name, (uint32_t)(t_total / iter));
+}
+
+TEST_CASE("Random pread latency", TAG){
+    /* Check out the tree before pread/pwrite restored the file offset lazily to compare */
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "flash_test");
+    TEST_ASSERT_NOT_NULL(part);
+    /* 1MB, or as much as the test partition comfortably holds */
+    const size_t size = MIN(1024 * 1024, part->size / 2);
+    const char *path = "/littlefs/pread.bin";
+    esp_vfs_littlefs_conf_t conf = {
+        .base_path = "/littlefs",
+        .partition_label = "flash_test",
+        .format_if_mount_failed = true
+    };
+    TEST_ESP_OK(esp_littlefs_format(conf.partition_label));
+    TEST_ESP_OK(esp_vfs_littlefs_register(&conf));
+
+    uint8_t *buf = malloc(4096);
+    TEST_ASSERT_NOT_NULL(buf);
+    memset(buf, 0x3C, 4096);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+    for(size_t n=0; n < size; n += 4096) {
+        TEST_ASSERT_EQUAL(4096, write(fd, buf, 4096));
+    }
+    TEST_ASSERT_EQUAL(0, close(fd));
+    free(buf);
+
+    printf("LittleFS, %uKB file:\n", (unsigned)(size / 1024));
+    fd = open(path, O_RDONLY);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+    random_pread_test(fd, size, size, false, "pread anywhere:");
+    random_pread_test(fd, size, MAX(CONFIG_LITTLEFS_CACHE_SIZE, 128), false, "pread within one cache:");
+    random_pread_test(fd, size, size, true, "pread anywhere + sequential read:");
+    TEST_ASSERT_EQUAL(0, close(fd));
+
+    TEST_ESP_OK(esp_vfs_littlefs_unregister(conf.partition_label));
+}
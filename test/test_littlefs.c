@@ -111,6 +111,106 @@ TEST_CASE("can read from file with offset (pread)", "[littlefs]")
     test_teardown();
 }
 
+TEST_CASE("pread and pwrite keep the file offset", "[littlefs]")
+{
+    const char *filename = littlefs_base_path "/offset.txt";
+    char buf[16] = {0};
+
+    test_setup();
+    test_littlefs_create_file_with_text(filename, "0123456789");
+
+    int fd = open(filename, O_RDWR);
+    TEST_ASSERT_GREATER_OR_EQUAL_INT(0, fd);
+    TEST_ASSERT_EQUAL(2, read(fd, buf, 2));
+    TEST_ASSERT_EQUAL_STRING_LEN("01", buf, 2);
+
+    /* Positional accesses back to back, then the offset is still where read() left it */
+    TEST_ASSERT_EQUAL(2, pread(fd, buf, 2, 6));
+    TEST_ASSERT_EQUAL_STRING_LEN("67", buf, 2);
+    TEST_ASSERT_EQUAL(1, pwrite(fd, "X", 1, 0));
+    TEST_ASSERT_EQUAL(2, pread(fd, buf, 2, 0));
+    TEST_ASSERT_EQUAL_STRING_LEN("X1", buf, 2);
+    TEST_ASSERT_EQUAL(2, lseek(fd, 0, SEEK_CUR));
+
+    TEST_ASSERT_EQUAL(2, read(fd, buf, 2));
+    TEST_ASSERT_EQUAL_STRING_LEN("23", buf, 2);
+    TEST_ASSERT_EQUAL(1, pwrite(fd, "Z", 1, 9));
+    TEST_ASSERT_EQUAL(1, write(fd, "Y", 1));
+    TEST_ASSERT_EQUAL(0, close(fd));
+
+    fd = open(filename, O_RDONLY);
+    TEST_ASSERT_GREATER_OR_EQUAL_INT(0, fd);
+    memset(buf, 0, sizeof(buf));
+    TEST_ASSERT_EQUAL(10, read(fd, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_STRING("X123Y5678Z", buf);
+    TEST_ASSERT_EQUAL(0, close(fd));
+
+    test_teardown();
+}
+
+TEST_CASE("reads across blocks, after seeks and after writes", "[littlefs]")
+{
+    /* Covers the zero-copy mmap read path, which tracks the file position itself */
+    const char *filename = littlefs_base_path "/blocks.bin";
+    const size_t size = 3 * littlefs_test_block_size + 100;
+    uint8_t *buf = malloc(size);
+    TEST_ASSERT_NOT_NULL(buf);
+
+    test_setup();
+    for (size_t i = 0; i < size; i++) {
+        buf[i] = i * 7;
+    }
+    int fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0666);
+    TEST_ASSERT_GREATER_OR_EQUAL_INT(0, fd);
+    TEST_ASSERT_EQUAL(size, write(fd, buf, size));
+    TEST_ASSERT_EQUAL(0, close(fd));
+
+    fd = open(filename, O_RDWR);
+    TEST_ASSERT_GREATER_OR_EQUAL_INT(0, fd);
+
+    /* Small reads that straddle a block boundary */
+    const off_t start = littlefs_test_block_size - 50;
+    TEST_ASSERT_EQUAL(start, lseek(fd, start, SEEK_SET));
+    for (size_t i = 0; i < 4; i++) {
+        uint8_t chunk[30];
+        TEST_ASSERT_EQUAL(sizeof(chunk), read(fd, chunk, sizeof(chunk)));
+        for (size_t j = 0; j < sizeof(chunk); j++) {
+            TEST_ASSERT_EQUAL_HEX8((uint8_t)((start + i * sizeof(chunk) + j) * 7), chunk[j]);
+        }
+    }
+
+    /* One read spanning every block, then past the end */
+    memset(buf, 0, size);
+    TEST_ASSERT_EQUAL(0, lseek(fd, 0, SEEK_SET));
+    TEST_ASSERT_EQUAL(size, read(fd, buf, size));
+    for (size_t i = 0; i < size; i++) {
+        TEST_ASSERT_EQUAL_HEX8((uint8_t)(i * 7), buf[i]);
+    }
+    TEST_ASSERT_EQUAL(0, read(fd, buf, 1));
+
+    /* Backwards seek into an earlier block */
+    uint8_t b;
+    TEST_ASSERT_EQUAL(10, lseek(fd, 10, SEEK_SET));
+    TEST_ASSERT_EQUAL(1, read(fd, &b, 1));
+    TEST_ASSERT_EQUAL_HEX8((uint8_t)(10 * 7), b);
+
+    /* Written data is read back through the same handle before it's flushed */
+    const off_t woff = 2 * littlefs_test_block_size - 2;
+    TEST_ASSERT_EQUAL(woff, lseek(fd, woff, SEEK_SET));
+    TEST_ASSERT_EQUAL(4, write(fd, "WXYZ", 4));
+    TEST_ASSERT_EQUAL(woff - 2, lseek(fd, woff - 2, SEEK_SET));
+    char text[8];
+    TEST_ASSERT_EQUAL(8, read(fd, text, sizeof(text)));
+    TEST_ASSERT_EQUAL_HEX8((uint8_t)((woff - 2) * 7), text[0]);
+    TEST_ASSERT_EQUAL_HEX8((uint8_t)((woff - 1) * 7), text[1]);
+    TEST_ASSERT_EQUAL_STRING_LEN("WXYZ", text + 2, 4);
+    TEST_ASSERT_EQUAL_HEX8((uint8_t)((woff + 4) * 7), text[6]);
+    TEST_ASSERT_EQUAL(0, close(fd));
+
+    free(buf);
+    test_teardown();
+}
+
 TEST_CASE("r+ mode read and write file", "[littlefs]")
 {
     /* Note: despite some online resources, "r+" should not create a file
@@ -384,9 +484,10 @@ TEST_CASE("mnonce support", "[littlefs]")
     printf("mtime=%d\n", nonce1);
     TEST_ASSERT(nonce1 >= 0);
 
-    /* open again, check that mtime is updated */
+    /* open again, check that mtime is updated once the file is closed */
     int nonce2;
     FILE *f = fopen(filename, "a");
+    TEST_ASSERT_EQUAL(0, fclose(f));
     TEST_ASSERT_EQUAL(0, test_littlefs_stat(filename, &st));
     nonce2 = (int) st.st_mtime;
     printf("mtime=%d\n", nonce2);
@@ -396,7 +497,6 @@ TEST_CASE("mnonce support", "[littlefs]")
     else {
         TEST_ASSERT_EQUAL_INT(1, nonce2-nonce1);
     }
-    TEST_ASSERT_EQUAL(0, fclose(f));
 
     /* open for reading, check that mtime is not updated */
     int nonce3;
@@ -947,6 +1047,365 @@ TEST_CASE("fcntl get flags", "[littlefs]")
     test_teardown();
 }
 
+#ifdef CONFIG_LITTLEFS_BLOCK_CACHE
+TEST_CASE("block cache serves repeated metadata reads", "[littlefs]")
+{
+    test_setup();
+
+    const char *fn = littlefs_base_path "/cached.txt";
+    test_littlefs_create_file_with_text(fn, littlefs_test_hello_str);
+
+    esp_littlefs_block_cache_stats_t stats;
+    TEST_ESP_OK(esp_littlefs_block_cache_stats(littlefs_test_partition_label, &stats, true));
+
+    for (int i = 0; i < 16; i++) {
+        test_littlefs_read_file(fn);
+    }
+
+    TEST_ESP_OK(esp_littlefs_block_cache_stats(littlefs_test_partition_label, &stats, false));
+    TEST_ASSERT_GREATER_THAN(stats.misses, stats.hits);
+
+    /* Buffered writes must be on flash after a remount */
+    test_teardown();
+    const esp_vfs_littlefs_conf_t conf = {
+        .base_path = littlefs_base_path,
+        .partition_label = littlefs_test_partition_label,
+    };
+    TEST_ESP_OK(esp_vfs_littlefs_register(&conf));
+    test_littlefs_read_file(fn);
+    TEST_ESP_OK(esp_vfs_littlefs_unregister(littlefs_test_partition_label));
+}
+#endif
+
+#ifdef CONFIG_LITTLEFS_WEAR_TRACKING
+TEST_CASE("wear tracking counts erases per block", "[littlefs]")
+{
+    esp_littlefs_wear_stats_t before, after;
+    size_t total_bytes;
+
+    test_setup();
+    TEST_ESP_OK(esp_littlefs_info(littlefs_test_partition_label, &total_bytes, NULL));
+    TEST_ESP_OK(esp_littlefs_wear_stats(littlefs_test_partition_label, &before));
+    TEST_ASSERT_EQUAL(total_bytes / littlefs_test_block_size, before.blocks);
+
+    const char *fn = littlefs_base_path "/wear.txt";
+    for (int i = 0; i < 32; i++) {
+        test_littlefs_create_file_with_text(fn, littlefs_test_hello_str);
+        TEST_ASSERT_EQUAL(0, unlink(fn));
+    }
+
+    TEST_ESP_OK(esp_littlefs_wear_stats(littlefs_test_partition_label, &after));
+    TEST_ASSERT_GREATER_THAN(before.total, after.total);
+    TEST_ASSERT_LESS_OR_EQUAL(after.max, after.mean);
+    TEST_ASSERT_GREATER_OR_EQUAL(after.min, after.mean);
+
+    uint32_t hist_total = 0;
+    for (int i = 0; i < ESP_LITTLEFS_WEAR_HIST_BUCKETS; i++) {
+        hist_total += after.hist[i];
+    }
+    TEST_ASSERT_EQUAL(after.blocks, hist_total);
+
+    test_teardown();
+}
+#endif
+
+#ifdef CONFIG_LITTLEFS_IO_STATS
+TEST_CASE("io stats count block device operations", "[littlefs]")
+{
+    esp_littlefs_io_stats_t stats;
+
+    test_setup();
+    TEST_ESP_OK(esp_littlefs_io_stats(littlefs_test_partition_label, NULL, true));
+    TEST_ESP_OK(esp_littlefs_io_stats(littlefs_test_partition_label, &stats, false));
+    TEST_ASSERT_EQUAL(0, stats.read.count);
+    TEST_ASSERT_EQUAL(0, stats.prog.count);
+
+    const char *fn = littlefs_base_path "/stats.txt";
+    test_littlefs_create_file_with_text(fn, littlefs_test_hello_str);
+    test_littlefs_read_file(fn);
+
+    TEST_ESP_OK(esp_littlefs_io_stats(littlefs_test_partition_label, &stats, false));
+    TEST_ASSERT_GREATER_THAN(0, stats.read.count);
+    TEST_ASSERT_GREATER_THAN(0, stats.prog.count);
+    TEST_ASSERT_GREATER_OR_EQUAL(stats.prog.count, stats.prog.bytes);
+    TEST_ASSERT_GREATER_OR_EQUAL(stats.read.max_us, stats.read.total_us);
+
+    uint32_t hist_total = 0;
+    for (int i = 0; i < ESP_LITTLEFS_IO_STATS_HIST_BUCKETS; i++) {
+        hist_total += stats.read.hist[i];
+    }
+    TEST_ASSERT_EQUAL(stats.read.count, hist_total);
+
+    test_teardown();
+}
+#endif
+
+#ifdef CONFIG_LITTLEFS_RAM_SUPPORT
+TEST_CASE("RAM-backed filesystem can be registered and unregistered", "[littlefs]")
+{
+    const char *ram_path = "/ramfs";
+    const esp_vfs_littlefs_conf_t conf = {
+        .base_path = ram_path,
+        .ram_size = 16 * littlefs_test_block_size,
+    };
+    size_t total_bytes, used_bytes;
+
+    TEST_ESP_OK(esp_vfs_littlefs_register(&conf));
+    TEST_ASSERT_TRUE(esp_littlefs_ram_mounted(ram_path));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, esp_vfs_littlefs_register(&conf));
+
+    TEST_ESP_OK(esp_littlefs_ram_info(ram_path, &total_bytes, &used_bytes));
+    TEST_ASSERT_EQUAL(conf.ram_size, total_bytes);
+
+    test_littlefs_create_file_with_text("/ramfs/scratch.txt", littlefs_test_hello_str);
+    test_littlefs_read_file_with_content("/ramfs/scratch.txt", littlefs_test_hello_str);
+
+    /* Formatting drops the file but keeps it mounted */
+    TEST_ESP_OK(esp_littlefs_format_ram(ram_path));
+    TEST_ASSERT_TRUE(esp_littlefs_ram_mounted(ram_path));
+    TEST_ASSERT_NULL(fopen("/ramfs/scratch.txt", "r"));
+
+    TEST_ESP_OK(esp_vfs_littlefs_unregister_ram(ram_path));
+    TEST_ASSERT_FALSE(esp_littlefs_ram_mounted(ram_path));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, esp_vfs_littlefs_unregister_ram(ram_path));
+
+    /* Contents don't survive unregistering */
+    TEST_ESP_OK(esp_vfs_littlefs_register(&conf));
+    TEST_ASSERT_NULL(fopen("/ramfs/scratch.txt", "r"));
+    TEST_ESP_OK(esp_vfs_littlefs_unregister_ram(ram_path));
+}
+#endif
+
+#ifdef CONFIG_LITTLEFS_OVERLAY
+TEST_CASE("write overlay defers flash writes until a checkpoint", "[littlefs]")
+{
+    const esp_vfs_littlefs_conf_t conf = {
+        .base_path = littlefs_base_path,
+        .partition_label = littlefs_test_partition_label,
+        .format_if_mount_failed = true,
+        .overlay = true,
+        /* No periodic checkpoint may land in the middle of the test */
+        .overlay_interval_ms = 3600000,
+    };
+    const char *fn = littlefs_base_path "/overlay.txt";
+    char text[32];
+
+    /* A filesystem spanning the whole partition leaves no room for the journal; it gets reformatted */
+    TEST_ESP_OK(esp_littlefs_format(littlefs_test_partition_label));
+    TEST_ESP_OK(esp_vfs_littlefs_register(&conf));
+
+#ifdef CONFIG_LITTLEFS_IO_STATS
+    esp_littlefs_io_stats_t stats;
+    TEST_ESP_OK(esp_littlefs_io_stats(littlefs_test_partition_label, NULL, true));
+#endif
+    /* Inline files only touch the root metadata pair, far from filling the overlay */
+    for (int i = 0; i < 10; i++) {
+        snprintf(text, sizeof(text), "rewrite %d\n", i);
+        test_littlefs_create_file_with_text(fn, text);
+    }
+#ifdef CONFIG_LITTLEFS_IO_STATS
+    TEST_ESP_OK(esp_littlefs_io_stats(littlefs_test_partition_label, &stats, false));
+    TEST_ASSERT_EQUAL(0, stats.prog.count);
+    TEST_ASSERT_EQUAL(0, stats.erase.count);
+#endif
+
+    TEST_ESP_OK(esp_littlefs_checkpoint(littlefs_test_partition_label));
+#ifdef CONFIG_LITTLEFS_IO_STATS
+    TEST_ESP_OK(esp_littlefs_io_stats(littlefs_test_partition_label, &stats, false));
+    TEST_ASSERT_GREATER_THAN(0, stats.prog.count);
+#endif
+    TEST_ESP_OK(esp_vfs_littlefs_unregister(littlefs_test_partition_label));
+
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, esp_littlefs_checkpoint(littlefs_test_partition_label));
+
+    /* The flash holds the last version without the overlay in front of it */
+    const esp_vfs_littlefs_conf_t plain = {
+        .base_path = littlefs_base_path,
+        .partition_label = littlefs_test_partition_label,
+    };
+    TEST_ESP_OK(esp_vfs_littlefs_register(&plain));
+    test_littlefs_read_file_with_content(fn, text);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, esp_littlefs_checkpoint(littlefs_test_partition_label));
+    TEST_ESP_OK(esp_vfs_littlefs_unregister(littlefs_test_partition_label));
+}
+#endif
+
+#ifdef CONFIG_LITTLEFS_ARENA
+TEST_CASE("arena serves open files and directories", "[littlefs]")
+{
+    const esp_vfs_littlefs_conf_t conf = {
+        .base_path = littlefs_base_path,
+        .partition_label = littlefs_test_partition_label,
+        .format_if_mount_failed = true,
+        .arena = true,
+        .arena_files = 2,
+        .arena_dirs = 1,
+    };
+    const char *names[] = {
+        littlefs_base_path "/arena0.txt",
+        littlefs_base_path "/arena1.txt",
+        littlefs_base_path "/arena2.txt",
+    };
+    esp_littlefs_arena_stats_t stats;
+    int fds[3];
+
+    TEST_ESP_OK(esp_littlefs_format(littlefs_test_partition_label));
+    TEST_ESP_OK(esp_vfs_littlefs_register(&conf));
+
+    TEST_ESP_OK(esp_littlefs_arena_stats(littlefs_test_partition_label, &stats));
+    TEST_ASSERT_GREATER_THAN(0, stats.size);
+    TEST_ASSERT_EQUAL(2, stats.file.slots);
+    TEST_ASSERT_EQUAL(2, stats.cache.in_use);
+    TEST_ASSERT_EQUAL(1, stats.lookahead.in_use);
+
+    /* The third file doesn't fit and comes from the heap */
+    for (int i = 0; i < 3; i++) {
+        fds[i] = open(names[i], O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        TEST_ASSERT_GREATER_OR_EQUAL(0, fds[i]);
+        TEST_ASSERT_EQUAL(strlen(littlefs_test_hello_str),
+                write(fds[i], littlefs_test_hello_str, strlen(littlefs_test_hello_str)));
+    }
+    TEST_ESP_OK(esp_littlefs_arena_stats(littlefs_test_partition_label, &stats));
+    TEST_ASSERT_EQUAL(2, stats.file.in_use);
+    TEST_ASSERT_EQUAL(1, stats.file.fallbacks);
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT_EQUAL(0, close(fds[i]));
+    }
+
+#ifdef CONFIG_VFS_SUPPORT_DIR
+    DIR *dir = opendir(littlefs_base_path);
+    TEST_ASSERT_NOT_NULL(dir);
+    TEST_ESP_OK(esp_littlefs_arena_stats(littlefs_test_partition_label, &stats));
+    TEST_ASSERT_EQUAL(1, stats.dir.in_use);
+    TEST_ASSERT_EQUAL(0, closedir(dir));
+#endif
+
+    for (int i = 0; i < 3; i++) {
+        test_littlefs_read_file(names[i]);
+    }
+    TEST_ESP_OK(esp_littlefs_arena_stats(littlefs_test_partition_label, &stats));
+    TEST_ASSERT_EQUAL(0, stats.file.in_use);
+    TEST_ASSERT_EQUAL(2, stats.file.high_water);
+    TEST_ASSERT_EQUAL(0, stats.dir.in_use);
+
+    TEST_ESP_OK(esp_vfs_littlefs_unregister(littlefs_test_partition_label));
+}
+#endif
+
+TEST_CASE("max_files and max_dirs preallocate open files and directories", "[littlefs]")
+{
+    const esp_vfs_littlefs_conf_t conf = {
+        .base_path = littlefs_base_path,
+        .partition_label = littlefs_test_partition_label,
+        .format_if_mount_failed = true,
+        .max_files = 2,
+        .max_dirs = 1,
+    };
+    const char *names[] = {
+        littlefs_base_path "/max0.txt",
+        littlefs_base_path "/max1.txt",
+    };
+    esp_littlefs_arena_stats_t stats;
+    int fds[2];
+
+    TEST_ESP_OK(esp_littlefs_format(littlefs_test_partition_label));
+    TEST_ESP_OK(esp_vfs_littlefs_register(&conf));
+
+    for (int i = 0; i < 2; i++) {
+        fds[i] = open(names[i], O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        TEST_ASSERT_GREATER_OR_EQUAL(0, fds[i]);
+    }
+
+    /* The pool is full and never falls back to the heap */
+    errno = 0;
+    TEST_ASSERT_EQUAL(-1, open(littlefs_base_path "/max2.txt", O_WRONLY | O_CREAT, 0666));
+    TEST_ASSERT_EQUAL(ENFILE, errno);
+
+    TEST_ESP_OK(esp_littlefs_arena_stats(littlefs_test_partition_label, &stats));
+    TEST_ASSERT_EQUAL(2, stats.file.slots);
+    TEST_ASSERT_EQUAL(2, stats.file.in_use);
+    TEST_ASSERT_EQUAL(0, stats.file.fallbacks);
+
+    /* A closed file frees its slot for the next open */
+    TEST_ASSERT_EQUAL(0, close(fds[1]));
+    fds[1] = open(names[1], O_RDONLY);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, fds[1]);
+    for (int i = 0; i < 2; i++) {
+        TEST_ASSERT_EQUAL(0, close(fds[i]));
+    }
+
+#ifdef CONFIG_VFS_SUPPORT_DIR
+    DIR *dir = opendir(littlefs_base_path);
+    TEST_ASSERT_NOT_NULL(dir);
+    errno = 0;
+    TEST_ASSERT_NULL(opendir(littlefs_base_path));
+    TEST_ASSERT_EQUAL(ENFILE, errno);
+    TEST_ASSERT_EQUAL(0, closedir(dir));
+    dir = opendir(littlefs_base_path);
+    TEST_ASSERT_NOT_NULL(dir);
+    TEST_ASSERT_EQUAL(0, closedir(dir));
+#endif
+
+    TEST_ESP_OK(esp_littlefs_arena_stats(littlefs_test_partition_label, &stats));
+    TEST_ASSERT_EQUAL(0, stats.file.in_use);
+    TEST_ASSERT_EQUAL(0, stats.dir.in_use);
+    TEST_ASSERT_EQUAL(0, stats.dir.fallbacks);
+
+    TEST_ESP_OK(esp_vfs_littlefs_unregister(littlefs_test_partition_label));
+
+    /* Too many for the file descriptor table */
+    esp_vfs_littlefs_conf_t too_many = conf;
+    too_many.max_files = UINT16_MAX;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, esp_vfs_littlefs_register(&too_many));
+}
+
+TEST_CASE("cache_size sizes the per-file caches of a mount", "[littlefs]")
+{
+    esp_vfs_littlefs_conf_t conf = {
+        .base_path = littlefs_base_path,
+        .partition_label = littlefs_test_partition_label,
+        .format_if_mount_failed = true,
+        .max_files = 1,
+        .cache_size = littlefs_test_block_size,
+    };
+    const char *fn = littlefs_base_path "/cache.bin";
+    const size_t size = 3 * littlefs_test_block_size + 100;
+    esp_littlefs_arena_stats_t stats;
+    uint8_t *buf = malloc(size);
+    TEST_ASSERT_NOT_NULL(buf);
+
+    TEST_ESP_OK(esp_littlefs_format(littlefs_test_partition_label));
+    TEST_ESP_OK(esp_vfs_littlefs_register(&conf));
+
+    /* The file's cache lives in its slot */
+    TEST_ESP_OK(esp_littlefs_arena_stats(littlefs_test_partition_label, &stats));
+    TEST_ASSERT_GREATER_OR_EQUAL(littlefs_test_block_size, stats.file.slot_size);
+
+    for (size_t i = 0; i < size; i++) {
+        buf[i] = i * 7;
+    }
+    int fd = open(fn, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+    TEST_ASSERT_EQUAL(size, write(fd, buf, size));
+    TEST_ASSERT_EQUAL(0, close(fd));
+
+    memset(buf, 0, size);
+    fd = open(fn, O_RDONLY);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, fd);
+    TEST_ASSERT_EQUAL(size, read(fd, buf, size));
+    TEST_ASSERT_EQUAL(0, close(fd));
+    for (size_t i = 0; i < size; i++) {
+        TEST_ASSERT_EQUAL_HEX8((uint8_t)(i * 7), buf[i]);
+    }
+    TEST_ESP_OK(esp_vfs_littlefs_unregister(littlefs_test_partition_label));
+
+    /* Must be a factor of the block size */
+    conf.cache_size = littlefs_test_block_size + CONFIG_LITTLEFS_CACHE_SIZE;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, esp_vfs_littlefs_register(&conf));
+
+    free(buf);
+}
+
 /**
  * Cannot use buitin `stat` since it depends on CONFIG_VFS_SUPPORT_DIR.
  */
@@ -25,7 +25,10 @@ typedef struct {
     size_t disk_size;
     size_t erase_size;
     bool strict_erase_alignment;
+    size_t read_calls;
+    size_t write_calls;
     size_t erase_calls;
+    size_t erase_bytes;
     size_t last_erase_len;
 } mock_bdl_ctx_t;
 
@@ -55,6 +58,7 @@ static esp_err_t mock_bdl_read(esp_blockdev_handle_t dev_handle, uint8_t *dst_bu
         return ESP_ERR_INVALID_ARG;
     }
 
+    ctx->read_calls++;
     memcpy(dst_buf, &ctx->storage[src_addr], data_read_len);
     return ESP_OK;
 }
@@ -73,13 +77,17 @@ static esp_err_t mock_bdl_write(esp_blockdev_handle_t dev_handle, const uint8_t
         return ESP_ERR_INVALID_SIZE;
     }
 
-    /* Enforce flash-like behavior for this mock: bytes must be erased before programming. */
-    for (size_t i = 0; i < data_write_len; i++) {
-        if (ctx->storage[dst_addr + i] != 0xFF) {
-            return ESP_ERR_INVALID_STATE;
+    /* Enforce flash-like behavior for this mock: bytes must be erased before programming.
+     * Logical-mode devices (erase_before_write=0) can be overwritten in place. */
+    if (dev_handle->device_flags.erase_before_write) {
+        for (size_t i = 0; i < data_write_len; i++) {
+            if (ctx->storage[dst_addr + i] != 0xFF) {
+                return ESP_ERR_INVALID_STATE;
+            }
         }
     }
 
+    ctx->write_calls++;
     memcpy(&ctx->storage[dst_addr], src_buf, data_write_len);
     return ESP_OK;
 }
@@ -96,6 +104,7 @@ static esp_err_t mock_bdl_erase(esp_blockdev_handle_t dev_handle, uint64_t start
     }
 
     ctx->erase_calls++;
+    ctx->erase_bytes += erase_len;
     ctx->last_erase_len = erase_len;
     memset(&ctx->storage[start_addr], 0xFF, erase_len);
     return ESP_OK;
@@ -543,6 +552,89 @@ TEST_CASE("bdl logical sector size uses lcm(read,write)", "[littlefs_bdl_geom]")
     mock_bdl_destroy_handle(handle);
 }
 
+TEST_CASE("bdl logical mode honours erase policy", "[littlefs_bdl_geom]")
+{
+    mock_bdl_params_t p = mock_bdl_default_params();
+    p.erase_before_write = false;
+    p.and_type_write = false;
+    p.strict_erase_alignment = false;
+
+    esp_blockdev_handle_t handle = NULL;
+    TEST_ASSERT_EQUAL(ESP_OK, try_register_mock_bdl(&p, false, true, true, &handle));
+    mock_bdl_ctx_t *ctx = (mock_bdl_ctx_t *)handle->ctx;
+    ctx->erase_calls = 0;
+
+    /* Rewrites force LittleFS to erase and reuse blocks */
+    const char *fn = littlefs_base_path "/policy.txt";
+    for (int i = 0; i < 8; i++) {
+        test_littlefs_create_file_with_text(fn, littlefs_test_hello_str);
+    }
+    test_littlefs_read_file(fn);
+
+#if CONFIG_LITTLEFS_ERASE_POLICY_SKIP
+    TEST_ASSERT_EQUAL(0, ctx->erase_calls);
+#elif CONFIG_LITTLEFS_ERASE_POLICY_IMMEDIATE
+    TEST_ASSERT_GREATER_THAN(0, ctx->erase_calls);
+#endif
+
+    /* Queued discards must never clobber blocks that were programmed afterwards */
+    TEST_ESP_OK(esp_vfs_littlefs_unregister_blockdev(handle));
+    mock_bdl_destroy_handle(handle);
+    TEST_ASSERT_EQUAL(ESP_OK, try_register_mock_bdl(&p, false, false, false, &handle));
+    test_littlefs_read_file(fn);
+
+    TEST_ESP_OK(esp_vfs_littlefs_unregister_blockdev(handle));
+    mock_bdl_destroy_handle(handle);
+}
+
+TEST_CASE("bdl logical mode device ops per MB written", "[littlefs_benchmark]")
+{
+    /* Build with different sdkconfigs to compare the erase policies */
+#if CONFIG_LITTLEFS_ERASE_POLICY_SKIP
+    const char *policy = "skip";
+#elif CONFIG_LITTLEFS_ERASE_POLICY_DEFERRED
+    const char *policy = "deferred discard";
+#else
+    const char *policy = "immediate";
+#endif
+    const size_t file_size = 4096;
+    const size_t total = 1024 * 1024;
+
+    /* eMMC-like: 512 byte sectors that can be overwritten in place */
+    mock_bdl_params_t p = mock_bdl_default_params();
+    p.erase_before_write = false;
+    p.and_type_write = false;
+    p.strict_erase_alignment = false;
+    p.read_size = 512;
+    p.write_size = 512;
+
+    esp_blockdev_handle_t handle = NULL;
+    TEST_ASSERT_EQUAL(ESP_OK, try_register_mock_bdl(&p, false, true, true, &handle));
+    mock_bdl_ctx_t *ctx = (mock_bdl_ctx_t *)handle->ctx;
+
+    uint8_t *buf = malloc(file_size);
+    TEST_ASSERT_NOT_NULL(buf);
+    memset(buf, 0xA5, file_size);
+
+    ctx->read_calls = ctx->write_calls = ctx->erase_calls = ctx->erase_bytes = 0;
+    uint64_t t_start = esp_timer_get_time();
+    for (size_t written = 0; written < total; written += file_size) {
+        FILE *f = fopen(littlefs_base_path "/ops.bin", "wb");
+        TEST_ASSERT_NOT_NULL(f);
+        TEST_ASSERT_EQUAL(file_size, fwrite(buf, 1, file_size, f));
+        TEST_ASSERT_EQUAL(0, fclose(f));
+    }
+    uint64_t t_total = esp_timer_get_time() - t_start;
+
+    printf("erase policy %s, per MB written: %u reads, %u writes, %u erases (%u KB) in %llu us\n",
+           policy, (unsigned)ctx->read_calls, (unsigned)ctx->write_calls,
+           (unsigned)ctx->erase_calls, (unsigned)(ctx->erase_bytes / 1024), t_total);
+
+    free(buf);
+    TEST_ESP_OK(esp_vfs_littlefs_unregister_blockdev(handle));
+    mock_bdl_destroy_handle(handle);
+}
+
 TEST_CASE("duplicate blockdev registration keeps existing mount intact", "[littlefs_bdl_geom]")
 {
     mock_bdl_params_t p = mock_bdl_default_params();
@@ -595,3 +687,372 @@ TEST_CASE("format blockdev does not consume caller handle", "[littlefs_bdl_geom]
 
     mock_bdl_destroy_handle(handle);
 }
+
+#ifdef CONFIG_LITTLEFS_STRIPE
+static uint8_t s_mock_bdl_storage1[MOCK_BDL_TEST_DISK_SIZE];
+
+/* Two mocks on separate media; the first one keeps the shared static buffer */
+static void stripe_mock_pair_create(esp_blockdev_handle_t *dev0, esp_blockdev_handle_t *dev1, bool reset_media)
+{
+    const mock_bdl_params_t p = mock_bdl_default_params();
+
+    TEST_ESP_OK(mock_bdl_create_custom(dev0, &p, reset_media));
+    TEST_ESP_OK(mock_bdl_create_custom(dev1, &p, false));
+    if (reset_media) {
+        memset(s_mock_bdl_storage1, 0xFF, sizeof(s_mock_bdl_storage1));
+    }
+    ((mock_bdl_ctx_t *)(*dev1)->ctx)->storage = s_mock_bdl_storage1;
+}
+
+static void stripe_fill(uint8_t *buf, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = (uint8_t)(i * 7 + (i >> 8));
+    }
+}
+
+TEST_CASE("bdl striping across two devices", "[littlefs_bdl_geom]")
+{
+    esp_blockdev_handle_t dev0 = NULL, dev1 = NULL, stripe = NULL;
+    const char *fn = littlefs_base_path "/striped.bin";
+    const size_t len = 6 * MOCK_BDL_TEST_ERASE_SIZE + 100;
+    uint8_t *expected = malloc(len);
+    uint8_t *actual = malloc(len);
+    TEST_ASSERT_NOT_NULL(expected);
+    TEST_ASSERT_NOT_NULL(actual);
+    stripe_fill(expected, len);
+
+    stripe_mock_pair_create(&dev0, &dev1, true);
+
+    /* Members must agree on their flags, and stripes must align to their erase size */
+    dev1->device_flags.erase_before_write = false;
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_SUPPORTED, esp_littlefs_stripe_bdl_create(dev0, dev1, 0, &stripe));
+    dev1->device_flags.erase_before_write = true;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG,
+                      esp_littlefs_stripe_bdl_create(dev0, dev1, MOCK_BDL_TEST_ERASE_SIZE + MOCK_BDL_TEST_WRITE_SIZE, &stripe));
+
+    /* Writable members must support write and erase */
+    const esp_blockdev_ops_t *ops = dev1->ops;
+    esp_blockdev_ops_t no_erase = *ops;
+    no_erase.erase = NULL;
+    dev1->ops = &no_erase;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, esp_littlefs_stripe_bdl_create(dev0, dev1, 0, &stripe));
+    dev1->ops = ops;
+
+    TEST_ESP_OK(esp_littlefs_stripe_bdl_create(dev0, dev1, 0, &stripe));
+    TEST_ASSERT_EQUAL(2 * MOCK_BDL_TEST_DISK_SIZE, stripe->geometry.disk_size);
+    TEST_ASSERT_EQUAL(2 * MOCK_BDL_TEST_ERASE_SIZE, stripe->geometry.erase_size);
+
+    esp_vfs_littlefs_conf_t conf = {
+        .base_path = littlefs_base_path,
+        .blockdev = stripe,
+        .format_if_mount_failed = true,
+    };
+    TEST_ESP_OK(esp_vfs_littlefs_register(&conf));
+
+    FILE *f = fopen(fn, "wb");
+    TEST_ASSERT_NOT_NULL(f);
+    TEST_ASSERT_EQUAL(len, fwrite(expected, 1, len, f));
+    TEST_ASSERT_EQUAL(0, fclose(f));
+
+    /* Every erase covers one stripe on each member */
+    mock_bdl_ctx_t *ctx0 = (mock_bdl_ctx_t *)dev0->ctx;
+    mock_bdl_ctx_t *ctx1 = (mock_bdl_ctx_t *)dev1->ctx;
+    TEST_ASSERT_GREATER_THAN(0, ctx0->erase_calls);
+    TEST_ASSERT_EQUAL(ctx0->erase_calls, ctx1->erase_calls);
+    TEST_ASSERT_EQUAL(MOCK_BDL_TEST_ERASE_SIZE, ctx0->last_erase_len);
+    TEST_ASSERT_EQUAL(MOCK_BDL_TEST_ERASE_SIZE, ctx1->last_erase_len);
+
+    /* Unregistering releases the striped device and both members */
+    TEST_ESP_OK(esp_vfs_littlefs_unregister_blockdev(stripe));
+    TEST_ASSERT_NULL(dev0->ops);
+    TEST_ASSERT_NULL(dev1->ops);
+    mock_bdl_destroy_handle(dev0);
+    mock_bdl_destroy_handle(dev1);
+
+    /* The data is read back from both media */
+    stripe_mock_pair_create(&dev0, &dev1, false);
+    TEST_ESP_OK(esp_littlefs_stripe_bdl_create(dev0, dev1, 0, &stripe));
+    conf.blockdev = stripe;
+    conf.format_if_mount_failed = false;
+    TEST_ESP_OK(esp_vfs_littlefs_register(&conf));
+
+    f = fopen(fn, "rb");
+    TEST_ASSERT_NOT_NULL(f);
+    TEST_ASSERT_EQUAL(len, fread(actual, 1, len, f));
+    TEST_ASSERT_EQUAL(0, fclose(f));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, actual, len);
+
+    TEST_ESP_OK(esp_vfs_littlefs_unregister_blockdev(stripe));
+    mock_bdl_destroy_handle(dev0);
+    mock_bdl_destroy_handle(dev1);
+    free(actual);
+    free(expected);
+}
+#endif
+
+/* Power-loss fault injection: wraps another BDL and cuts power on the Nth prog or erase. */
+typedef struct {
+    esp_blockdev_handle_t inner;
+    uint32_t ops;          /* progs + erases so far */
+    uint32_t cut_at;       /* op that loses power; 0 never */
+    uint32_t rng;
+    bool dead;             /* power is off; every further op fails */
+} powercut_bdl_ctx_t;
+
+static uint32_t powercut_rand(powercut_bdl_ctx_t *ctx)
+{
+    /* xorshift32, so every cut point replays the same tear */
+    ctx->rng ^= ctx->rng << 13;
+    ctx->rng ^= ctx->rng >> 17;
+    ctx->rng ^= ctx->rng << 5;
+    return ctx->rng;
+}
+
+static esp_err_t powercut_bdl_read(esp_blockdev_handle_t dev_handle, uint8_t *dst_buf,
+                                   size_t dst_buf_size, uint64_t src_addr, size_t data_read_len)
+{
+    powercut_bdl_ctx_t *ctx = (powercut_bdl_ctx_t *)dev_handle->ctx;
+    if (ctx->dead) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return ctx->inner->ops->read(ctx->inner, dst_buf, dst_buf_size, src_addr, data_read_len);
+}
+
+static esp_err_t powercut_bdl_write(esp_blockdev_handle_t dev_handle, const uint8_t *src_buf,
+                                    uint64_t dst_addr, size_t data_write_len)
+{
+    powercut_bdl_ctx_t *ctx = (powercut_bdl_ctx_t *)dev_handle->ctx;
+    if (ctx->dead) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (++ctx->ops == ctx->cut_at) {
+        /* Torn write: only a prefix of whole program units makes it to the media */
+        const size_t unit = ctx->inner->geometry.write_size;
+        const size_t torn = (powercut_rand(ctx) % (data_write_len / unit)) * unit;
+        if (torn) {
+            ctx->inner->ops->write(ctx->inner, src_buf, dst_addr, torn);
+        }
+        ctx->dead = true;
+        return ESP_ERR_INVALID_STATE;
+    }
+    return ctx->inner->ops->write(ctx->inner, src_buf, dst_addr, data_write_len);
+}
+
+static esp_err_t powercut_bdl_erase(esp_blockdev_handle_t dev_handle, uint64_t start_addr, size_t erase_len)
+{
+    powercut_bdl_ctx_t *ctx = (powercut_bdl_ctx_t *)dev_handle->ctx;
+    if (ctx->dead) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (++ctx->ops == ctx->cut_at) {
+        /* Interrupted erase: the sector is either left untouched or already erased */
+        if (powercut_rand(ctx) & 1) {
+            ctx->inner->ops->erase(ctx->inner, start_addr, erase_len);
+        }
+        ctx->dead = true;
+        return ESP_ERR_INVALID_STATE;
+    }
+    return ctx->inner->ops->erase(ctx->inner, start_addr, erase_len);
+}
+
+static esp_err_t powercut_bdl_sync(esp_blockdev_handle_t dev_handle)
+{
+    powercut_bdl_ctx_t *ctx = (powercut_bdl_ctx_t *)dev_handle->ctx;
+    if (ctx->dead) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return ctx->inner->ops->sync(ctx->inner);
+}
+
+static esp_err_t powercut_bdl_release(esp_blockdev_handle_t dev_handle)
+{
+    powercut_bdl_ctx_t *ctx = (powercut_bdl_ctx_t *)dev_handle->ctx;
+    if (ctx) {
+        mock_bdl_destroy_handle(ctx->inner);
+        free(ctx);
+        dev_handle->ctx = NULL;
+    }
+    dev_handle->ops = NULL;
+    return ESP_OK;
+}
+
+static const esp_blockdev_ops_t s_powercut_bdl_ops = {
+    .read = powercut_bdl_read,
+    .write = powercut_bdl_write,
+    .erase = powercut_bdl_erase,
+    .sync = powercut_bdl_sync,
+    .ioctl = NULL,
+    .release = powercut_bdl_release,
+};
+
+/**
+ * Wrap a fresh mock BDL (on the persistent mock media) with power-loss injection.
+ *
+ * @param cut_at Prog/erase that loses power, counted from 1; 0 never loses power.
+ */
+static esp_blockdev_handle_t powercut_bdl_create(const mock_bdl_params_t *params, bool reset_media, uint32_t cut_at)
+{
+    esp_blockdev_handle_t inner = NULL;
+    TEST_ESP_OK(mock_bdl_create_custom(&inner, params, reset_media));
+
+    esp_blockdev_handle_t dev = calloc(1, sizeof(*dev));
+    powercut_bdl_ctx_t *ctx = calloc(1, sizeof(*ctx));
+    TEST_ASSERT_NOT_NULL(dev);
+    TEST_ASSERT_NOT_NULL(ctx);
+
+    ctx->inner = inner;
+    ctx->cut_at = cut_at;
+    ctx->rng = cut_at * 2654435761u + 1;
+
+    dev->ctx = ctx;
+    dev->device_flags = inner->device_flags;
+    dev->geometry = inner->geometry;
+    dev->ops = &s_powercut_bdl_ops;
+    return dev;
+}
+
+static esp_err_t powercut_bdl_mount(esp_blockdev_handle_t handle, bool format_if_mount_failed)
+{
+    const esp_vfs_littlefs_conf_t conf = {
+        .base_path = littlefs_base_path,
+        .blockdev = handle,
+        .format_if_mount_failed = format_if_mount_failed,
+    };
+    return esp_vfs_littlefs_register(&conf);
+}
+
+static void powercut_bdl_unmount(esp_blockdev_handle_t handle)
+{
+    TEST_ESP_OK(esp_vfs_littlefs_unregister_blockdev(handle));
+    mock_bdl_destroy_handle(handle);
+}
+
+#define POWERCUT_RECORD_SIZE 24
+#define POWERCUT_RECORDS     96
+
+typedef struct {
+    uint32_t ops;          /* progs + erases issued before the cut (or in total) */
+    size_t written;        /* bytes acknowledged by write() */
+    size_t synced;         /* bytes acknowledged by fsync() */
+} powercut_workload_t;
+
+/* Append records to a log file, fsync()ing every sync_every records, until power is lost. */
+static void powercut_run_workload(esp_blockdev_handle_t handle, int sync_every, powercut_workload_t *out)
+{
+    uint8_t rec[POWERCUT_RECORD_SIZE];
+    memset(out, 0, sizeof(*out));
+
+    int fd = open(littlefs_base_path "/log.bin", O_WRONLY | O_CREAT | O_APPEND, 0666);
+    if (fd >= 0) {
+        for (int i = 0; i < POWERCUT_RECORDS; i++) {
+            memset(rec, (uint8_t)i, sizeof(rec));
+            if (write(fd, rec, sizeof(rec)) != sizeof(rec)) {
+                break;
+            }
+            out->written += sizeof(rec);
+            if ((i + 1) % sync_every == 0) {
+                if (fsync(fd) != 0) {
+                    break;
+                }
+                out->synced = out->written;
+            }
+        }
+        close(fd);
+    }
+    out->ops = ((powercut_bdl_ctx_t *)handle->ctx)->ops;
+}
+
+/* Check the surviving log is an intact prefix of what was written; returns its length. */
+static size_t powercut_check_log(void)
+{
+    uint8_t rec[POWERCUT_RECORD_SIZE];
+    size_t len = 0;
+
+    int fd = open(littlefs_base_path "/log.bin", O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+    ssize_t n;
+    while ((n = read(fd, rec, sizeof(rec))) > 0) {
+        TEST_ASSERT_EQUAL(sizeof(rec), n);
+        for (size_t i = 0; i < sizeof(rec); i++) {
+            TEST_ASSERT_EQUAL_UINT8((uint8_t)(len / sizeof(rec)), rec[i]);
+        }
+        len += n;
+    }
+    close(fd);
+    return len;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Cut power at every prog/erase of the workload in turn, remount, and report the
+ * mount latency distribution and the data lost for the given fsync policy.
+ * Data acknowledged by fsync() must always survive.
+ */
+static void powercut_sweep(const mock_bdl_params_t *params, int sync_every)
+{
+    powercut_workload_t clean, run;
+
+    /* Dry run without a power cut, to learn how many cut points there are. Format with
+     * a separate handle like the sweep does, so the format's ops aren't counted. */
+    esp_blockdev_handle_t handle = powercut_bdl_create(params, true, 0);
+    TEST_ESP_OK(powercut_bdl_mount(handle, true));
+    powercut_bdl_unmount(handle);
+
+    handle = powercut_bdl_create(params, false, 0);
+    TEST_ESP_OK(powercut_bdl_mount(handle, false));
+    powercut_run_workload(handle, sync_every, &clean);
+    powercut_bdl_unmount(handle);
+
+    uint32_t *mount_us = calloc(clean.ops, sizeof(uint32_t));
+    TEST_ASSERT_NOT_NULL(mount_us);
+    size_t lost_written_max = 0, lost_written_total = 0;
+
+    for (uint32_t cut = 1; cut <= clean.ops; cut++) {
+        /* Fresh filesystem, then run the workload until power is lost */
+        handle = powercut_bdl_create(params, true, 0);
+        TEST_ESP_OK(powercut_bdl_mount(handle, true));
+        powercut_bdl_unmount(handle);
+
+        handle = powercut_bdl_create(params, false, cut);
+        TEST_ESP_OK(powercut_bdl_mount(handle, false));
+        powercut_run_workload(handle, sync_every, &run);
+        powercut_bdl_unmount(handle);
+
+        /* Power back on */
+        handle = powercut_bdl_create(params, false, 0);
+        int64_t t_start = esp_timer_get_time();
+        TEST_ESP_OK(powercut_bdl_mount(handle, false));
+        mount_us[cut - 1] = esp_timer_get_time() - t_start;
+
+        size_t survived = powercut_check_log();
+        TEST_ASSERT_GREATER_OR_EQUAL(run.synced, survived);
+        size_t lost = run.written > survived ? run.written - survived : 0;
+        lost_written_max = MAX(lost_written_max, lost);
+        lost_written_total += lost;
+
+        powercut_bdl_unmount(handle);
+    }
+
+    qsort(mount_us, clean.ops, sizeof(uint32_t), cmp_u32);
+    printf("fsync every %d records, %" PRIu32 " cut points: mount p50 %" PRIu32 " us, p99 %" PRIu32 " us, max %" PRIu32 " us; "
+           "acknowledged writes lost: avg %u, max %u bytes\n",
+           sync_every, clean.ops,
+           mount_us[clean.ops / 2], mount_us[clean.ops * 99 / 100], mount_us[clean.ops - 1],
+           (unsigned)(lost_written_total / clean.ops), (unsigned)lost_written_max);
+    free(mount_us);
+}
+
+TEST_CASE("bdl power loss at every prog/erase keeps fsynced data", "[littlefs_bdl_powerloss]")
+{
+    const mock_bdl_params_t p = mock_bdl_default_params();
+    powercut_sweep(&p, 1);
+    powercut_sweep(&p, 8);
+}
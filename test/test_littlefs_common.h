@@ -31,6 +31,7 @@
 #include <time.h>
 
 #define littlefs_base_path "/littlefs"
+#define littlefs_test_block_size 4096 /* Block size of the flash test partition */
 extern const char littlefs_test_partition_label[];
 extern const char littlefs_test_hello_str[];
 